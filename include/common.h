@@ -5,14 +5,14 @@
 #ifndef PROJECT_BASE_COMMON_H
 #define PROJECT_BASE_COMMON_H
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <learnopengl/asset_pack.h>
 
+// from the asset pack when it holds the file, otherwise from disk. Empty if the file cannot be read.
 std::string readFileContents(std::string path) {
-    std::ifstream in(path);
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    return buffer.str();
+    AssetData data;
+    if (!data.Open(path))
+        return std::string();
+    return data.String();
 }
 
 
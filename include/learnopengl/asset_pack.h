@@ -0,0 +1,497 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// all assets in one memory-mapped file, so startup maps a single file instead of opening every shader, model and image.
+// stored entries are served straight from the mapping (zero copy), compressed ones are inflated into a buffer on open.
+// the pack is an optional layer: AssetData::Open() looks into the open pack first and falls back to the loose file,
+// so everything keeps working without a pack, and assets missing from an outdated pack are still found on disk.
+//
+// on-disk layout of a .pack file (built by tools/asset_packer):
+//   AssetPackHeader
+//   entry blobs, each aligned to ASSET_PACK_ALIGNMENT, in path order so the files of one model are next to each other
+//   path strings
+//   AssetPackEntry[entryCount], sorted by path hash, then path
+
+const uint32_t ASSET_PACK_VERSION = 1;
+const uint64_t ASSET_PACK_ALIGNMENT = 16;
+
+enum class AssetCompression : uint32_t {
+    None = 0,
+    LZ = 1      // LZ4 block format, see lz::Compress
+};
+
+struct AssetPackHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t entriesOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+struct AssetPackEntry
+{
+    uint64_t pathHash;
+    uint32_t nameOffset;    // into the path strings
+    uint32_t nameLength;
+    uint64_t offset;
+    uint64_t storedSize;    // bytes in the pack
+    uint64_t size;          // bytes once inflated
+    int64_t  mtime;         // of the source file when it was packed, stands in for stat() on packed assets
+    uint32_t compression;   // AssetCompression
+    uint32_t reserved;
+};
+
+namespace lz {
+
+// greedy LZ77 in the LZ4 block format: a token with 4-bit literal and match lengths, the literals, a 16-bit offset and
+// length continuation bytes of 255. Fast to inflate and good at the text assets (OBJ, MTL, GLSL); images are already compressed.
+inline std::vector<unsigned char> Compress(const unsigned char *source, size_t size)
+{
+    const unsigned int HASH_BITS = 16;
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 65535;
+    std::vector<unsigned char> out;
+    out.reserve(size + size / 255 + 16);
+    std::vector<uint32_t> table(1u << HASH_BITS, 0);   // last position + 1 of every hashed 4-byte sequence
+    auto read32 = [&](size_t at) {
+        uint32_t value;
+        std::memcpy(&value, source + at, sizeof(value));
+        return value;
+    };
+    auto emitLength = [&](size_t length) {
+        for (; length >= 255; length -= 255)
+            out.push_back(255);
+        out.push_back((unsigned char)length);
+    };
+
+    size_t anchor = 0;
+    // the format wants the last 5 bytes as literals and no match starting in the last 12
+    for (size_t i = 0; size >= 12 && i + 12 <= size;)
+    {
+        uint32_t sequence = read32(i);
+        uint32_t slot = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = (uint32_t)(i + 1);
+        if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET || read32(candidate - 1) != sequence)
+        {
+            i++;
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t length = MIN_MATCH;
+        while (i + length < size - 5 && source[match + length] == source[i + length])
+            length++;
+
+        size_t literals = i - anchor;
+        out.push_back((unsigned char)((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(length - MIN_MATCH, 15)));
+        if (literals >= 15)
+            emitLength(literals - 15);
+        out.insert(out.end(), source + anchor, source + i);
+        size_t offset = i - match;
+        out.push_back((unsigned char)(offset & 0xff));
+        out.push_back((unsigned char)(offset >> 8));
+        if (length - MIN_MATCH >= 15)
+            emitLength(length - MIN_MATCH - 15);
+        i += length;
+        anchor = i;
+    }
+    size_t literals = size - anchor;
+    out.push_back((unsigned char)(std::min<size_t>(literals, 15) << 4));
+    if (literals >= 15)
+        emitLength(literals - 15);
+    out.insert(out.end(), source + anchor, source + size);
+    return out;
+}
+
+// inflates exactly size bytes into destination, false if the stream is corrupt
+inline bool Decompress(const unsigned char *source, size_t storedSize, unsigned char *destination, size_t size)
+{
+    const unsigned char *in = source, *inEnd = source + storedSize;
+    unsigned char *out = destination, *outEnd = destination + size;
+    auto readLength = [&](size_t length, bool &ok) {
+        unsigned char byte = 255;
+        while (byte == 255 && (ok = in < inEnd))
+        {
+            byte = *in++;
+            length += byte;
+        }
+        return length;
+    };
+    while (in < inEnd)
+    {
+        unsigned char token = *in++;
+        bool ok = true;
+        size_t literals = token >> 4;
+        if (literals == 15)
+            literals = readLength(literals, ok);
+        if (!ok || literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out))
+            return false;
+        std::memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+        if (in == inEnd)
+            break;      // the last sequence has no match
+        if (inEnd - in < 2)
+            return false;
+        size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15)
+            length = readLength(length, ok);
+        length += 4;
+        if (!ok || offset == 0 || offset > (size_t)(out - destination) || length > (size_t)(outEnd - out))
+            return false;
+        const unsigned char *match = out - offset;
+        if (offset >= length)
+            std::memcpy(out, match, length);
+        else
+        {
+            // the match overlaps the bytes it produces, copy byte by byte
+            for (size_t k = 0; k < length; k++)
+                out[k] = match[k];
+        }
+        out += length;
+    }
+    return out == outEnd;
+}
+
+} // namespace lz
+
+// lexically normalized relative path: no "." segments, no repeated or trailing slashes, ".." resolved where possible.
+// pack entries are stored normalized, so "resources/objects/island/./island.mtl" finds "resources/objects/island/island.mtl".
+inline std::string NormalizeAssetPath(const std::string &path)
+{
+    std::vector<std::string> parts;
+    bool absolute = !path.empty() && path[0] == '/';
+    for (size_t begin = 0; begin <= path.size();)
+    {
+        size_t end = path.find('/', begin);
+        if (end == std::string::npos)
+            end = path.size();
+        std::string part = path.substr(begin, end - begin);
+        if (part == "..")
+        {
+            if (!parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else if (!absolute)
+                parts.push_back(part);
+        }
+        else if (!part.empty() && part != ".")
+            parts.push_back(part);
+        begin = end + 1;
+    }
+    std::string normalized = absolute ? "/" : "";
+    for (size_t i = 0; i < parts.size(); i++)
+        normalized += (i ? "/" : "") + parts[i];
+    return normalized;
+}
+
+// the process-wide pack. Open() it once at startup, before any loader thread runs; lookups are read-only afterwards.
+class AssetPack
+{
+public:
+    static AssetPack &Instance()
+    {
+        static AssetPack pack;
+        return pack;
+    }
+
+    // maps the pack. Entry paths are relative to the directory of the pack, absolute paths under that directory are found too.
+    bool Open(const std::string &path)
+    {
+        Close();
+        if (!file.Open(path) || file.Size() < sizeof(AssetPackHeader))
+            return fail();
+        std::memcpy(&header, file.Data(), sizeof(header));
+        uint64_t size = file.Size();
+        if (std::memcmp(header.magic, "LOGLPAK", 8) != 0 || header.version != ASSET_PACK_VERSION ||
+            header.entriesOffset % alignof(AssetPackEntry) != 0 || header.entriesOffset > size ||
+            (uint64_t)header.entryCount * sizeof(AssetPackEntry) > size - header.entriesOffset ||
+            header.namesOffset > size || header.namesSize > size - header.namesOffset)
+            return fail();
+        entries = reinterpret_cast<const AssetPackEntry *>(file.Data() + header.entriesOffset);
+        names = reinterpret_cast<const char *>(file.Data() + header.namesOffset);
+        for (uint32_t i = 0; i < header.entryCount; i++)
+        {
+            const AssetPackEntry &entry = entries[i];
+            if ((uint64_t)entry.nameOffset + entry.nameLength > header.namesSize || entry.offset > size ||
+                entry.storedSize > size - entry.offset ||
+                (entry.compression == (uint32_t)AssetCompression::None && entry.storedSize != entry.size) ||
+                entry.compression > (uint32_t)AssetCompression::LZ)
+                return fail();
+        }
+        std::string directory = path.find('/') == std::string::npos ? "." : path.substr(0, path.find_last_of('/'));
+        char *resolved = realpath(directory.c_str(), nullptr);
+        root = resolved ? std::string(resolved) + '/' : "";
+        std::free(resolved);
+        packPath = path;
+        return true;
+    }
+
+    void Close()
+    {
+        file.Close();
+        entries = nullptr;
+        names = nullptr;
+        std::memset(&header, 0, sizeof(header));
+        root.clear();
+        packPath.clear();
+    }
+
+    bool IsOpen() const { return entries != nullptr; }
+    uint32_t EntryCount() const { return IsOpen() ? header.entryCount : 0; }
+    size_t Size() const { return file.Size(); }
+    const std::string &Path() const { return packPath; }
+
+    // the entry of a path, nullptr when the pack is not open or does not contain it
+    const AssetPackEntry *Find(const std::string &path) const
+    {
+        if (!IsOpen())
+            return nullptr;
+        std::string key = NormalizeAssetPath(path);
+        if (!key.empty() && key[0] == '/')
+        {
+            if (root.empty() || key.compare(0, root.size(), root) != 0)
+                return nullptr;
+            key.erase(0, root.size());
+        }
+        uint64_t hash = HashBytes(key.data(), key.size());
+        const AssetPackEntry *end = entries + header.entryCount;
+        const AssetPackEntry *entry = std::lower_bound(entries, end, hash,
+                                                       [](const AssetPackEntry &e, uint64_t h) { return e.pathHash < h; });
+        for (; entry != end && entry->pathHash == hash; entry++)
+            if (entry->nameLength == key.size() && std::memcmp(names + entry->nameOffset, key.data(), key.size()) == 0)
+                return entry;
+        return nullptr;
+    }
+
+    const unsigned char *Blob(const AssetPackEntry &entry) const { return file.Data() + entry.offset; }
+
+    std::string Name(const AssetPackEntry &entry) const { return std::string(names + entry.nameOffset, entry.nameLength); }
+
+private:
+    MappedFile file;
+    AssetPackHeader header = AssetPackHeader();
+    const AssetPackEntry *entries = nullptr;
+    const char *names = nullptr;
+    std::string root;
+    std::string packPath;
+
+    AssetPack() = default;
+
+    bool fail()
+    {
+        Close();
+        return false;
+    }
+};
+
+// size and modification time of an asset, from the pack when it holds the asset and from stat() otherwise.
+// the caches keyed on their source (mesh cache, compressed textures) use this, so they stay valid when the source is packed.
+inline bool StatAsset(const std::string &path, uint64_t &size, int64_t &mtime)
+{
+    if (const AssetPackEntry *entry = AssetPack::Instance().Find(path))
+    {
+        size = entry->size;
+        mtime = entry->mtime;
+        return true;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    size = (uint64_t)st.st_size;
+    mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+inline bool AssetExists(const std::string &path)
+{
+    uint64_t size;
+    int64_t mtime;
+    return StatAsset(path, size, mtime);
+}
+
+// the bytes of one asset: a view into the pack, an inflated copy of a compressed entry, or a mapping of the loose file.
+// move-only, the bytes stay valid while the AssetData is alive.
+class AssetData
+{
+public:
+    AssetData() = default;
+    AssetData(const AssetData &) = delete;
+    AssetData &operator=(const AssetData &) = delete;
+    AssetData(AssetData &&other) noexcept { *this = std::move(other); }
+    AssetData &operator=(AssetData &&other) noexcept
+    {
+        if (this != &other)
+        {
+            file = std::move(other.file);
+            inflated = std::move(other.inflated);
+            data = other.data;
+            size = other.size;
+            packed = other.packed;
+            other.data = nullptr;
+            other.size = 0;
+            other.packed = false;
+        }
+        return *this;
+    }
+
+    bool Open(const std::string &path)
+    {
+        Close();
+        const AssetPack &pack = AssetPack::Instance();
+        if (const AssetPackEntry *entry = pack.Find(path))
+        {
+            if (entry->compression == (uint32_t)AssetCompression::None)
+                data = pack.Blob(*entry);
+            else
+            {
+                inflated.resize(entry->size);
+                if (!lz::Decompress(pack.Blob(*entry), entry->storedSize, inflated.data(), inflated.size()))
+                {
+                    std::fprintf(stderr, "ERROR::ASSET_PACK:: corrupt entry %s\n", path.c_str());
+                    inflated.clear();
+                    return false;
+                }
+                data = inflated.data();
+            }
+            size = entry->size;
+            packed = true;
+            return true;
+        }
+        if (!file.Open(path))
+            return false;
+        data = file.Data();
+        size = file.Size();
+        return true;
+    }
+
+    void Close()
+    {
+        file.Close();
+        std::vector<unsigned char>().swap(inflated);
+        data = nullptr;
+        size = 0;
+        packed = false;
+    }
+
+    bool IsOpen() const { return data != nullptr; }
+    bool IsPacked() const { return packed; }
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+    std::string String() const { return std::string(reinterpret_cast<const char *>(data), size); }
+
+private:
+    MappedFile file;
+    std::vector<unsigned char> inflated;
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    bool packed = false;
+};
+
+struct AssetPackStats {
+    size_t files = 0;
+    size_t compressed = 0;      // entries stored compressed
+    uint64_t sourceBytes = 0;
+    uint64_t packBytes = 0;
+};
+
+// writes a pack of the given files, stored under their normalized paths. With compress set, an entry is stored
+// compressed when that saves at least an eighth of it. Written next to the target and renamed, like the mesh cache.
+inline bool WriteAssetPack(const std::string &packPath, std::vector<std::string> paths, bool compress, AssetPackStats &stats)
+{
+    for (std::string &path : paths)
+        path = NormalizeAssetPath(path);
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    std::vector<unsigned char> out(sizeof(AssetPackHeader), 0);
+    auto align = [&]() { out.resize((out.size() + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT, 0); };
+    std::vector<AssetPackEntry> entries;
+    std::string names;
+    for (const std::string &path : paths)
+    {
+        MappedFile source;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        // empty files cannot be mapped, they are stored as empty entries
+        if (st.st_size > 0 && !source.Open(path))
+            return false;
+        AssetPackEntry entry = AssetPackEntry();
+        entry.pathHash = HashBytes(path.data(), path.size());
+        entry.nameOffset = (uint32_t)names.size();
+        entry.nameLength = (uint32_t)path.size();
+        entry.size = source.Size();
+        entry.mtime = (int64_t)st.st_mtime;
+        entry.compression = (uint32_t)AssetCompression::None;
+        names += path;
+
+        align();
+        entry.offset = out.size();
+        std::vector<unsigned char> packed;
+        if (compress && source.Size() > 0)
+            packed = lz::Compress(source.Data(), source.Size());
+        if (!packed.empty() && packed.size() <= source.Size() - source.Size() / 8)
+        {
+            entry.compression = (uint32_t)AssetCompression::LZ;
+            out.insert(out.end(), packed.begin(), packed.end());
+            stats.compressed++;
+        }
+        else if (source.Size() > 0)
+            out.insert(out.end(), source.Data(), source.Data() + source.Size());
+        entry.storedSize = out.size() - entry.offset;
+        entries.push_back(entry);
+        stats.files++;
+        stats.sourceBytes += entry.size;
+    }
+
+    AssetPackHeader header = AssetPackHeader();
+    std::memcpy(header.magic, "LOGLPAK", 8);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t)entries.size();
+    header.namesOffset = out.size();
+    header.namesSize = names.size();
+    out.insert(out.end(), names.begin(), names.end());
+    align();
+    header.entriesOffset = out.size();
+    std::sort(entries.begin(), entries.end(), [&](const AssetPackEntry &a, const AssetPackEntry &b) {
+        if (a.pathHash != b.pathHash)
+            return a.pathHash < b.pathHash;
+        return names.compare(a.nameOffset, a.nameLength, names, b.nameOffset, b.nameLength) < 0;
+    });
+    const unsigned char *table = reinterpret_cast<const unsigned char *>(entries.data());
+    out.insert(out.end(), table, table + entries.size() * sizeof(AssetPackEntry));
+    std::memcpy(out.data(), &header, sizeof(header));
+    stats.packBytes = out.size();
+
+    std::string tmpPath = packPath + ".tmp";
+    FILE *f = std::fopen(tmpPath.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmpPath.c_str(), packPath.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef ASSET_PACK_IO_H
+#define ASSET_PACK_IO_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <learnopengl/asset_pack.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+// ASSIMP file access through AssetData, so models and the files they reference (MTL libraries) are read from the
+// asset pack when it holds them and from disk otherwise. Read-only: opening for writing fails.
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+    explicit AssetIOStream(AssetData &&data) : data(std::move(data)) {}
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+        size_t items = std::min(count, (data.Size() - position) / size);
+        std::memcpy(buffer, data.Data() + position, items * size);
+        position += items * size;
+        return items;
+    }
+
+    size_t Write(const void *, size_t, size_t) override { return 0; }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t target;
+        switch (origin)
+        {
+            case aiOrigin_SET: target = offset; break;
+            case aiOrigin_CUR: target = position + offset; break;
+            case aiOrigin_END: target = data.Size() - offset; break;
+            default: return aiReturn_FAILURE;
+        }
+        if (target > data.Size())
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return data.Size(); }
+    void Flush() override {}
+
+private:
+    AssetData data;
+    size_t position = 0;
+};
+
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char *path) const override { return AssetExists(path); }
+
+    char getOsSeparator() const override { return '/'; }
+
+    Assimp::IOStream *Open(const char *path, const char *mode = "rb") override
+    {
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a') || std::strchr(mode, '+'))
+            return nullptr;
+        AssetData data;
+        if (!data.Open(path))
+            return nullptr;
+        return new AssetIOStream(std::move(data));
+    }
+
+    void Close(Assimp::IOStream *stream) override { delete stream; }
+};
+
+#endif
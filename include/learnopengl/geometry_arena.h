@@ -0,0 +1,348 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/memory_stats.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// first-fit suballocator over [0, capacity) elements. The free ranges are kept sorted by offset and merged with their
+// neighbours when a range is freed, so space released next to a hole becomes one larger hole.
+class RangeAllocator
+{
+public:
+    static const uint32_t NONE = 0xFFFFFFFFu;
+
+    // the offset of size free elements, NONE when no hole is large enough. A size of 0 takes nothing and returns 0.
+    uint32_t Allocate(uint32_t size)
+    {
+        if (size == 0)
+            return 0;
+        for (size_t i = 0; i < holes.size(); i++)
+        {
+            if (holes[i].size < size)
+                continue;
+            uint32_t offset = holes[i].offset;
+            holes[i].offset += size;
+            holes[i].size -= size;
+            if (holes[i].size == 0)
+                holes.erase(holes.begin() + i);
+            freeTotal -= size;
+            return offset;
+        }
+        return NONE;
+    }
+
+    void Free(uint32_t offset, uint32_t size)
+    {
+        if (size == 0)
+            return;
+        auto next = std::lower_bound(holes.begin(), holes.end(), offset,
+                                     [](const Hole &hole, uint32_t value) { return hole.offset < value; });
+        size_t i = (size_t)(next - holes.begin());
+        holes.insert(next, Hole{offset, size});
+        freeTotal += size;
+        if (i + 1 < holes.size() && holes[i].offset + holes[i].size == holes[i + 1].offset)
+        {
+            holes[i].size += holes[i + 1].size;
+            holes.erase(holes.begin() + i + 1);
+        }
+        if (i > 0 && holes[i - 1].offset + holes[i - 1].size == holes[i].offset)
+        {
+            holes[i - 1].size += holes[i].size;
+            holes.erase(holes.begin() + i);
+        }
+    }
+
+    // [0, used) taken and [used, capacity) free, the state after compaction
+    void Reset(uint32_t used, uint32_t newCapacity)
+    {
+        holes.clear();
+        capacity = newCapacity;
+        freeTotal = newCapacity - used;
+        if (freeTotal)
+            holes.push_back(Hole{used, freeTotal});
+    }
+
+    uint32_t Capacity() const { return capacity; }
+    uint32_t FreeTotal() const { return freeTotal; }
+    uint32_t Used() const { return capacity - freeTotal; }
+    size_t HoleCount() const { return holes.size(); }
+
+private:
+    struct Hole
+    {
+        uint32_t offset;
+        uint32_t size;
+    };
+    std::vector<Hole> holes;
+    uint32_t capacity = 0;
+    uint32_t freeTotal = 0;
+};
+
+// where a mesh lives in its arena: indices start at firstIndex and are relative to baseVertex
+struct GeometryRange
+{
+    uint32_t baseVertex;
+    uint32_t firstIndex;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    bool live;
+};
+
+// scene-wide vertex and index pools: every mesh of one vertex format and index type is a range of the same VBO and EBO
+// behind one VAO, so switching between meshes costs no VAO bind and runs of them can go out as one
+// glMultiDrawElementsBaseVertex. Meshes hold a handle, not the offsets, because growing the pools compacts them and
+// moves the ranges; Compact() does the same on demand, after models were unloaded.
+class GeometryArena
+{
+public:
+    static const uint32_t MIN_VERTICES = 1u << 16;
+    static const uint32_t MIN_INDICES = 1u << 18;
+
+    // the arena of a vertex format and index type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT), created on first use
+    static GeometryArena &For(VertexFormat format, GLenum indexType)
+    {
+        for (const std::unique_ptr<GeometryArena> &arena : arenas())
+            if (arena->format == format && arena->indexType == indexType)
+                return *arena;
+        arenas().emplace_back(new GeometryArena(format, indexType));
+        return *arenas().back();
+    }
+
+    // copies vertices (in the GPU layout of the format) and indices into the pools and returns the handle of the range
+    uint32_t Allocate(const void *vertices, uint32_t vertexCount, const void *indices, uint32_t indexCount)
+    {
+        uint32_t baseVertex = vertexSpace.Allocate(vertexCount);
+        uint32_t firstIndex = indexSpace.Allocate(indexCount);
+        if (baseVertex == RangeAllocator::NONE || firstIndex == RangeAllocator::NONE)
+        {
+            if (baseVertex != RangeAllocator::NONE)
+                vertexSpace.Free(baseVertex, vertexCount);
+            if (firstIndex != RangeAllocator::NONE)
+                indexSpace.Free(firstIndex, indexCount);
+            makeRoom(vertexCount, indexCount);
+            baseVertex = vertexSpace.Allocate(vertexCount);
+            firstIndex = indexSpace.Allocate(indexCount);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(baseVertex * stride), (GLsizeiptr)(vertexCount * stride), vertices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(firstIndex * indexSize), (GLsizeiptr)(indexCount * indexSize), indices);
+
+        GeometryRange range = {baseVertex, firstIndex, vertexCount, indexCount, true};
+        if (!freeHandles.empty())
+        {
+            uint32_t handle = freeHandles.back();
+            freeHandles.pop_back();
+            ranges[handle] = range;
+            return handle;
+        }
+        ranges.push_back(range);
+        return (uint32_t)(ranges.size() - 1);
+    }
+
+    // returns the range to the free lists, the data stays in the buffers until it is overwritten
+    void Free(uint32_t handle)
+    {
+        GeometryRange &range = ranges[handle];
+        if (!range.live)
+            return;
+        vertexSpace.Free(range.baseVertex, range.vertexCount);
+        indexSpace.Free(range.firstIndex, range.indexCount);
+        range.live = false;
+        freeHandles.push_back(handle);
+    }
+
+    const GeometryRange &Range(uint32_t handle) const { return ranges[handle]; }
+
+    // moves every live range to the front of the pools, turning the holes left by freed ranges into one free block
+    void Compact()
+    {
+        rebuild(vertexSpace.Capacity(), indexSpace.Capacity());
+    }
+
+    GLuint VAO() const { return vao; }
+
+    // a second VAO over the same buffers for instanced draws, created on first use. InstanceBuffer::Attach enables the
+    // instance attributes (divisor 1) on it, so the plain VAO the other draws of the arena use never has them enabled.
+    GLuint InstancedVAO()
+    {
+        if (instancedVao == 0)
+        {
+            glGenVertexArrays(1, &instancedVao);
+            // without buffers yet the first rebuild points it
+            if (vbo)
+                pointAttributes(instancedVao);
+        }
+        return instancedVao;
+    }
+    GLenum IndexType() const { return indexType; }
+    size_t IndexSize() const { return indexSize; }
+
+    // deletes the GL objects of every arena, call while the GL context is still current and after every mesh
+    // allocated from them was released: a mesh still holding a range would free it into a deleted arena.
+    static void ReleaseAll()
+    {
+        for (const std::unique_ptr<GeometryArena> &arena : arenas())
+        {
+            GLState::Instance().DeleteVertexArray(arena->vao);
+            if (arena->instancedVao)
+                GLState::Instance().DeleteVertexArray(arena->instancedVao);
+            glDeleteBuffers(1, &arena->vbo);
+            glDeleteBuffers(1, &arena->ebo);
+        }
+        arenas().clear();
+    }
+
+    static void PrintStats()
+    {
+        for (const std::unique_ptr<GeometryArena> &arena : arenas())
+        {
+            const GeometryArena &a = *arena;
+            std::cout << "GEOMETRY::ARENA:: " << VertexFormatName(a.format) << (a.indexType == GL_UNSIGNED_SHORT ? " 16" : " 32")
+                      << "-bit: " << (a.ranges.size() - a.freeHandles.size()) << " meshes, vertices "
+                      << BytesToMB((size_t)a.vertexSpace.Used() * a.stride) << "/" << BytesToMB((size_t)a.vertexSpace.Capacity() * a.stride)
+                      << " MB, indices " << BytesToMB((size_t)a.indexSpace.Used() * a.indexSize) << "/"
+                      << BytesToMB((size_t)a.indexSpace.Capacity() * a.indexSize) << " MB, "
+                      << a.vertexSpace.HoleCount() + a.indexSpace.HoleCount() << " holes, " << a.rebuilds << " rebuilds" << std::endl;
+        }
+    }
+
+private:
+    VertexFormat format;
+    GLenum indexType;
+    size_t stride;
+    size_t indexSize;
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    GLuint instancedVao = 0;
+    RangeAllocator vertexSpace, indexSpace;
+    std::vector<GeometryRange> ranges;
+    std::vector<uint32_t> freeHandles;
+    unsigned int rebuilds = 0;
+
+    GeometryArena(VertexFormat format, GLenum indexType)
+        : format(format), indexType(indexType), stride(VertexStride(format)),
+          indexSize(indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int))
+    {
+        glGenVertexArrays(1, &vao);
+    }
+
+    static std::vector<std::unique_ptr<GeometryArena>> &arenas()
+    {
+        static std::vector<std::unique_ptr<GeometryArena>> all;
+        return all;
+    }
+
+    // compacting is enough when the holes add up to the request, otherwise the pool that is short doubles
+    void makeRoom(uint32_t vertexCount, uint32_t indexCount)
+    {
+        uint32_t vertexCapacity = vertexSpace.Capacity(), indexCapacity = indexSpace.Capacity();
+        if (vertexSpace.FreeTotal() < vertexCount)
+            vertexCapacity = std::max({MIN_VERTICES, vertexCapacity * 2, vertexSpace.Used() + vertexCount});
+        if (indexSpace.FreeTotal() < indexCount)
+            indexCapacity = std::max({MIN_INDICES, indexCapacity * 2, indexSpace.Used() + indexCount});
+        rebuild(vertexCapacity, indexCapacity);
+    }
+
+    // new buffers of the given capacity with the live ranges copied to their front, in handle order
+    void rebuild(uint32_t vertexCapacity, uint32_t indexCapacity)
+    {
+        GLuint newVbo, newEbo;
+        glGenBuffers(1, &newVbo);
+        glGenBuffers(1, &newEbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(vertexCapacity * stride), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newEbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(indexCapacity * indexSize), nullptr, GL_STATIC_DRAW);
+
+        uint32_t vertexEnd = 0, indexEnd = 0;
+        for (GeometryRange &range : ranges)
+        {
+            if (!range.live)
+                continue;
+            copy(vbo, newVbo, range.baseVertex * stride, vertexEnd * stride, range.vertexCount * stride);
+            copy(ebo, newEbo, range.firstIndex * indexSize, indexEnd * indexSize, range.indexCount * indexSize);
+            range.baseVertex = vertexEnd;
+            range.firstIndex = indexEnd;
+            vertexEnd += range.vertexCount;
+            indexEnd += range.indexCount;
+        }
+        vertexSpace.Reset(vertexEnd, vertexCapacity);
+        indexSpace.Reset(indexEnd, indexCapacity);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        vbo = newVbo;
+        ebo = newEbo;
+        pointAttributes(vao);
+        if (instancedVao)
+            pointAttributes(instancedVao);
+        rebuilds++;
+    }
+
+    static void copy(GLuint from, GLuint to, size_t fromOffset, size_t toOffset, size_t bytes)
+    {
+        if (bytes == 0)
+            return;
+        glBindBuffer(GL_COPY_READ_BUFFER, from);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, to);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)fromOffset, (GLintptr)toOffset, (GLsizeiptr)bytes);
+    }
+
+    // the vertex attribute pointers and element buffer of a VAO of the arena, for the current buffers
+    void pointAttributes(GLuint target)
+    {
+        GLState::Instance().BindVertexArray(target);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        switch (format)
+        {
+            case VertexFormat::Full:
+                // vertex Positions
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+                // vertex normals
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+                // vertex texture coords
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+                // vertex tangent
+                glEnableVertexAttribArray(3);
+                glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+                // vertex bitangent
+                glEnableVertexAttribArray(4);
+                glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+                break;
+            case VertexFormat::Packed:
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+                // the hardware unpacks the 10:10:10:2 and half-float attributes, the shaders still see vec3/vec2
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+                // tangent as vec4, w is the bitangent sign. There is no bitangent attribute (location 4) in this layout.
+                // Only the sign of w is defined: GL 3.3 converts snorm as (2c + 1) / (2^b - 1), so the 2-bit -1 arrives
+                // as -1/3 (GL 4.2+ clamps it to -1). Shaders rebuild the bitangent as cross(N, T) * sign(w), never * w
+                glEnableVertexAttribArray(3);
+                glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+                break;
+            case VertexFormat::PositionOnly:
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+                break;
+        }
+    }
+};
+
+#endif
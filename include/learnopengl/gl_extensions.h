@@ -0,0 +1,95 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_set>
+
+// glad is generated for plain GL 3.3 core without extensions, so the few extensions we use are queried here
+// and their enums declared by hand.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+// ARB_get_program_binary, core since 4.1
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile, same enums for both
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// entry points of the extensions above, null when the context does not support them
+struct GLExtensionFunctions {
+    PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads = nullptr;
+    // GL_COMPLETION_STATUS_KHR can be queried on shaders and programs without blocking
+    bool parallelShaderCompile = false;
+};
+
+inline GLExtensionFunctions &GLExtensions()
+{
+    static GLExtensionFunctions functions;
+    return functions;
+}
+
+// returns whether the current context exposes the given extension. The list is read once, call after gladLoadGLLoader.
+inline bool HasGLExtension(const char *name)
+{
+    static std::unordered_set<std::string> extensions;
+    static bool queried = false;
+    if (!queried)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            extensions.insert(reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i)));
+        queried = true;
+    }
+    return extensions.count(name) != 0;
+}
+
+// true if the context is at least the given GL version
+inline bool HasGLVersion(int major, int minor)
+{
+    return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// loads the extension entry points with the same loader glad was given. Call once, after gladLoadGLLoader.
+inline void LoadGLExtensions(GLADloadproc load)
+{
+    GLExtensionFunctions &functions = GLExtensions();
+    if (HasGLVersion(4, 1) || HasGLExtension("GL_ARB_get_program_binary"))
+    {
+        functions.GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        functions.ProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+        functions.ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+    }
+    if (HasGLExtension("GL_KHR_parallel_shader_compile"))
+        functions.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+    else if (HasGLExtension("GL_ARB_parallel_shader_compile"))
+        functions.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+    functions.parallelShaderCompile = functions.MaxShaderCompilerThreads != nullptr;
+}
+
+#endif
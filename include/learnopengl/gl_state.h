@@ -0,0 +1,240 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// shadow copy of the GL state the renderer changes: bound program, VAO, active texture unit, the 2D and cube map
+// texture of every unit, blend/depth/cull switches and their functions. Renderer code makes these calls through
+// GLState::Instance(), which only forwards a call when it changes something and counts the ones it skips.
+//
+// the shadow is only right if nothing else changes the state: deleting textures, VAOs or programs must go through
+// Delete*() (a deleted name can come back from glGen* while the shadow still has it bound), and code that changes the
+// state directly (ImGui) has to be followed by Invalidate().
+struct GLStateStats
+{
+    unsigned long long issued = 0;   // calls forwarded to GL
+    unsigned long long elided = 0;   // calls skipped because the state already had the value
+};
+
+class GLState
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+    // when false every call is forwarded, to compare the driver overhead with and without the cache
+    bool elide = true;
+
+    static GLState &Instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    GLStateStats &Stats() { return stats; }
+
+    // forgets everything, the next call of each kind is forwarded
+    void Invalidate()
+    {
+        program = vertexArray = activeUnit = UNKNOWN;
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            textures[unit][0] = textures[unit][1] = UNKNOWN;
+        blend = depthTest = cullFace = depthMask = -1;
+        depthFunc = blendSrc = blendDst = cullMode = frontFace = UNKNOWN;
+    }
+
+    void UseProgram(GLuint id)
+    {
+        if (change(program, id))
+            glUseProgram(id);
+    }
+
+    void BindVertexArray(GLuint id)
+    {
+        if (change(vertexArray, id))
+            glBindVertexArray(id);
+    }
+
+    void ActiveTexture(unsigned int unit)
+    {
+        if (change(activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds the texture to the given unit, making the unit active only when the binding actually changes
+    void BindTexture(unsigned int unit, GLenum target, GLuint id)
+    {
+        GLuint *slot = textureSlot(unit, target);
+        if (slot && elide && *slot == id)
+        {
+            stats.elided++;
+            return;
+        }
+        ActiveTexture(unit);
+        if (slot)
+            *slot = id;
+        stats.issued++;
+        glBindTexture(target, id);
+    }
+
+    // binds on the active unit, for code that does not care which unit it uses (uploads)
+    void BindTexture(GLenum target, GLuint id)
+    {
+        if (activeUnit == UNKNOWN)
+            ActiveTexture(0);
+        BindTexture(activeUnit, target, id);
+    }
+
+    // GL_BLEND, GL_DEPTH_TEST or GL_CULL_FACE; other capabilities are forwarded untracked
+    void SetEnabled(GLenum capability, bool enabled)
+    {
+        int *flag = capability == GL_BLEND ? &blend : capability == GL_DEPTH_TEST ? &depthTest :
+                    capability == GL_CULL_FACE ? &cullFace : nullptr;
+        if (flag && !change(*flag, enabled ? 1 : 0))
+            return;
+        if (!flag)
+            stats.issued++;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    void DepthMask(bool write)
+    {
+        if (change(depthMask, write ? 1 : 0))
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void DepthFunc(GLenum func)
+    {
+        if (change(depthFunc, func))
+            glDepthFunc(func);
+    }
+
+    void BlendFunc(GLenum src, GLenum dst)
+    {
+        if (elide && blendSrc == src && blendDst == dst)
+        {
+            stats.elided++;
+            return;
+        }
+        blendSrc = src;
+        blendDst = dst;
+        stats.issued++;
+        glBlendFunc(src, dst);
+    }
+
+    void CullFace(GLenum mode)
+    {
+        if (change(cullMode, mode))
+            glCullFace(mode);
+    }
+
+    void FrontFace(GLenum mode)
+    {
+        if (change(frontFace, mode))
+            glFrontFace(mode);
+    }
+
+    void DeleteTexture(GLuint id)
+    {
+        // GL falls back to texture 0 on every unit the texture was bound to
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (GLuint &bound : textures[unit])
+                if (bound == id)
+                    bound = 0;
+        glDeleteTextures(1, &id);
+    }
+
+    void DeleteVertexArray(GLuint id)
+    {
+        if (vertexArray == id)
+            vertexArray = 0;
+        // a VAO generated later under the same name starts without instance attributes
+        instanceSources.erase(std::remove_if(instanceSources.begin(), instanceSources.end(),
+                                             [id](const std::pair<GLuint, GLuint> &entry) { return entry.first == id; }),
+                              instanceSources.end());
+        glDeleteVertexArrays(1, &id);
+    }
+
+    void DeleteProgram(GLuint id)
+    {
+        // a deleted program stays in use until another one is, so only the name is forgotten
+        if (program == id)
+            program = UNKNOWN;
+        glDeleteProgram(id);
+    }
+
+    // the instance buffer the instance attributes of a VAO point at, 0 when they were never pointed anywhere (see
+    // InstanceBuffer::Attach). Attribute pointers are VAO state, so unlike the rest this survives Invalidate().
+    GLuint InstanceSource(GLuint vao) const
+    {
+        for (const std::pair<GLuint, GLuint> &entry : instanceSources)
+            if (entry.first == vao)
+                return entry.second;
+        return 0;
+    }
+
+    void SetInstanceSource(GLuint vao, GLuint buffer)
+    {
+        for (std::pair<GLuint, GLuint> &entry : instanceSources)
+        {
+            if (entry.first == vao)
+            {
+                entry.second = buffer;
+                return;
+            }
+        }
+        instanceSources.push_back({vao, buffer});
+    }
+
+    // for a deleted instance buffer: the VAOs pointing at it have to be pointed again before their next draw
+    void ForgetInstanceSource(GLuint buffer)
+    {
+        instanceSources.erase(std::remove_if(instanceSources.begin(), instanceSources.end(),
+                                             [buffer](const std::pair<GLuint, GLuint> &entry) { return entry.second == buffer; }),
+                              instanceSources.end());
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLuint program, vertexArray, activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][2];   // GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP
+    int blend, depthTest, cullFace, depthMask;
+    GLenum depthFunc, blendSrc, blendDst, cullMode, frontFace;
+    GLStateStats stats;
+    std::vector<std::pair<GLuint, GLuint>> instanceSources;   // (VAO, instance buffer), a handful of entries
+
+    GLState() { Invalidate(); }
+
+    template <typename T>
+    bool change(T &current, T value)
+    {
+        if (elide && current == value)
+        {
+            stats.elided++;
+            return false;
+        }
+        current = value;
+        stats.issued++;
+        return true;
+    }
+
+    GLuint *textureSlot(unsigned int unit, GLenum target)
+    {
+        if (unit >= MAX_TEXTURE_UNITS)
+            return nullptr;
+        if (target == GL_TEXTURE_2D)
+            return &textures[unit][0];
+        if (target == GL_TEXTURE_CUBE_MAP)
+            return &textures[unit][1];
+        return nullptr;
+    }
+};
+
+#endif
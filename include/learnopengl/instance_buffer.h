@@ -0,0 +1,101 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// one instance of an instanced draw, read by light.vs compiled with INSTANCED
+struct InstanceData {
+    glm::mat4 model;    // placement of the instance, without the spin
+    float spin;         // radians per second around the local y axis, turned into a rotation by the shader from its time uniform
+    glm::mat3 normalMatrix; // NormalMatrix(model), the shader applies the spin to it
+};
+
+// first attribute location of the instance data, after the vertex attributes of the meshes (0-4)
+const GLuint INSTANCE_ATTRIBUTE = 5;
+
+// per-instance data streamed to the GPU once per frame and read with an attribute divisor of 1, so a whole batch of
+// copies of a mesh is one glDrawElementsInstanced call. Update() orphans the storage like UniformBuffer does, the
+// buffer only grows, so a steady instance count reallocates nothing. Instanced draws use the instanced VAO of the
+// mesh's geometry arena (Mesh::InstancedVAO), which every mesh of the arena shares, so several buffers can take turns
+// on it; Attach() right before the draw. The plain VAO of the arena never has the instance attributes enabled.
+class InstanceBuffer
+{
+public:
+    InstanceBuffer()
+    {
+        glGenBuffers(1, &id);
+    }
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // deletes the buffer, call while the GL context is still current
+    void Release()
+    {
+        GLState::Instance().ForgetInstanceSource(id);
+        glDeleteBuffers(1, &id);
+        id = 0;
+        capacity = count = 0;
+    }
+
+    void Update(const InstanceData *instances, size_t instanceCount)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+        capacity = std::max(capacity, instanceCount);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+        if (instanceCount)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(InstanceData), instances);
+        count = instanceCount;
+    }
+
+    void Update(const std::vector<InstanceData> &instances) { Update(instances.data(), instances.size()); }
+
+    // points the instance attributes of the VAO at this buffer. The pointers are VAO state, so this only does GL
+    // calls when the VAO last pointed at another buffer (GLState tracks which one).
+    void Attach(GLuint vao)
+    {
+        GLState &state = GLState::Instance();
+        if (state.InstanceSource(vao) == id)
+            return;
+        state.SetInstanceSource(vao, id);
+        state.BindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, id);
+        // a mat4 attribute takes four consecutive locations, one per column
+        for (GLuint column = 0; column < 4; column++)
+        {
+            GLuint location = INSTANCE_ATTRIBUTE + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + 4);
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE + 4, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, spin));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE + 4, 1);
+        for (GLuint column = 0; column < 3; column++)
+        {
+            GLuint location = INSTANCE_ATTRIBUTE + 5 + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                  (void*)(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3)));
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+
+    // instances written by the last Update()
+    GLsizei Count() const { return (GLsizei)count; }
+
+private:
+    GLuint id = 0;
+    size_t capacity = 0;
+    size_t count = 0;
+};
+
+#endif
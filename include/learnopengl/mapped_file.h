@@ -0,0 +1,90 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// 64-bit FNV-1a, good enough to detect that a source asset changed on disk.
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// read-only memory mapping of a whole file. Move-only, unmaps on destruction.
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0) {}
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept : data(other.data), size(other.size)
+    {
+        other.data = nullptr;
+        other.size = 0;
+    }
+    MappedFile &operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+            std::swap(data, other.data);
+            std::swap(size, other.size);
+        }
+        return *this;
+    }
+
+    bool Open(const std::string &path)
+    {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+        void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping stays valid after the descriptor is closed
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = static_cast<const unsigned char *>(mapped);
+        size = (size_t)st.st_size;
+        return true;
+    }
+
+    void Close()
+    {
+        if (data)
+            munmap(const_cast<unsigned char *>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+
+    bool IsOpen() const { return data != nullptr; }
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char *data;
+    size_t size;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdio>
+
+// current resident set size of the process in bytes, read from /proc/self/statm. Returns 0 where that is not available.
+// freed heap memory is not always given back to the OS right away, so a drop shows up reliably only for large blocks.
+inline size_t ResidentSetBytes()
+{
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+    unsigned long totalPages = 0, residentPages = 0;
+    int fields = std::fscanf(statm, "%lu %lu", &totalPages, &residentPages);
+    std::fclose(statm);
+    if (fields != 2)
+        return 0;
+    return (size_t)residentPages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+inline double BytesToMB(size_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+#endif
@@ -6,26 +6,53 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/mesh_clusters.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
+
+
+// what a Mesh keeps of its geometry in CPU memory once it is uploaded. Draw() only needs the GL buffers.
+enum class GeometryRetention {
+    Keep,       // vertices and indices
+    Compact,    // positions and indices, enough for picking and collision
+    Release     // nothing, the geometry only lives in the GL buffers
 };
 
+inline const char *GeometryRetentionName(GeometryRetention policy)
+{
+    switch (policy)
+    {
+        case GeometryRetention::Keep: return "keep";
+        case GeometryRetention::Compact: return "compact";
+        default: return "release";
+    }
+}
+
+// what was submitted to the GPU, for the per-frame statistics. The application resets it at the start of each frame.
+struct RenderStats {
+    unsigned long long triangles = 0;
+    unsigned int drawCalls = 0;
+    unsigned int meshesCulled = 0;
+    unsigned int clustersDrawn = 0;
+    unsigned int clustersCulled = 0;
 
+    static RenderStats &Frame()
+    {
+        static RenderStats stats;
+        return stats;
+    }
+};
 
 struct Texture {
     unsigned int id;
@@ -33,37 +60,356 @@ struct Texture {
     string path;
 };
 
+// a texture as referenced by a mesh's material, resolved to a GL texture when the mesh is uploaded.
+struct TextureRef {
+    string type;
+    string path; // relative to the model directory
+    uint64_t content = 0;   // TextureRegistry::HashFile() of the file, filled in by Model::Import()
+    size_t fileBytes = 0;   // 0 when the file was not hashed or can not be read
+};
+
+// CPU-side result of importing one mesh. It is built without any GL calls, so it can be produced on a worker thread.
+// the geometry is either owned (vertices/indices) or borrowed from a memory-mapped mesh cache (vertexData/indexData).
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<TextureRef>   textures;
+    vector<MeshLod>      lods;      // ranges of indices (level 0 first), empty when the mesh has a single level
+    vector<MeshCluster>  clusters;  // of level 0, empty for small meshes
+
+    const Vertex       *vertexData = nullptr;
+    const unsigned int *indexData = nullptr;
+    unsigned int        vertexCount = 0;
+    unsigned int        indexCount = 0;
+
+    bool OwnsGeometry() const { return vertexData == nullptr; }
+    const Vertex *VertexData() const { return OwnsGeometry() ? vertices.data() : vertexData; }
+    const unsigned int *IndexData() const { return OwnsGeometry() ? indices.data() : indexData; }
+    unsigned int VertexCount() const { return OwnsGeometry() ? (unsigned int)vertices.size() : vertexCount; }
+    unsigned int IndexCount() const { return OwnsGeometry() ? (unsigned int)indices.size() : indexCount; }
+};
+
+// index ranges of one or more meshes of the same arena, submitted with one glMultiDrawElementsBaseVertex
+struct MultiDrawBatch {
+    vector<GLsizei>      counts;
+    vector<const void *> offsets;
+    vector<GLint>        baseVertices;
+    unsigned long long   triangles = 0;
+
+    void Clear()
+    {
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        triangles = 0;
+    }
+
+    bool Empty() const { return counts.empty(); }
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    vector<glm::vec3>    positions;  // only filled by GeometryRetention::Compact, vertices is empty then
 
-    unsigned int VAO;
+    unsigned int VAO;               // of the arena, shared by every mesh with the same vertex format and index type
+    unsigned int indexCount;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    VertexFormat vertexFormat = VertexFormat::Full;
+    size_t vertexBufferBytes = 0;   // size of the vertices in the arena, depends on vertexFormat
+    unsigned int indexType = GL_UNSIGNED_INT;   // GL_UNSIGNED_SHORT when all vertices are addressable with 16 bits
+    size_t indexBufferBytes = 0;
+    vector<MeshLod> lods;           // level 0 is the full mesh, all levels live in the one index buffer
+    glm::vec3 boundsCenter = glm::vec3(0.0f);   // object space bounding sphere
+    float boundsRadius = 0.0f;
+    vector<MeshCluster> clusters;   // ranges of level 0 with their bounds, for DrawClusters()
+    // constructor, takes over the storage of the vectors instead of copying them
+    Mesh(vector<Vertex> &&vertices, vector<unsigned int> &&indices, vector<Texture> textures, VertexFormat format = VertexFormat::Full)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), format);
+    }
+
+    // constructs a mesh straight from GPU-ready data owned by someone else (e.g. a memory-mapped mesh cache).
+    // the data is only read during upload, no CPU-side copy of the vertices/indices is kept.
+    Mesh(const Vertex *vertexData, unsigned int vertexCount, const unsigned int *indexData, unsigned int indexCount, vector<Texture> textures,
+         VertexFormat format = VertexFormat::Full)
+        : textures(std::move(textures))
+    {
+        setupMesh(vertexData, vertexCount, indexData, indexCount, format);
+    }
+
+    // a mesh owns its range of an arena and possibly megabytes of vertex data, so it can only be moved, never copied.
+    // the range goes back to the arena when the mesh is destroyed; freeing it is bookkeeping only, no GL call.
+    ~Mesh()
+    {
+        Release();
+    }
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    // the arena range goes with the mesh, the moved-from mesh is left empty and releasing it does nothing
+    Mesh(Mesh &&other) noexcept
+        : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)),
+          positions(std::move(other.positions)), VAO(other.VAO), indexCount(other.indexCount), glslIdentifierPrefix(std::move(other.glslIdentifierPrefix)),
+          vertexFormat(other.vertexFormat), vertexBufferBytes(other.vertexBufferBytes), indexType(other.indexType),
+          indexBufferBytes(other.indexBufferBytes), lods(std::move(other.lods)), boundsCenter(other.boundsCenter),
+          boundsRadius(other.boundsRadius), clusters(std::move(other.clusters)), arena(other.arena), allocation(other.allocation),
+          clusterBatch(std::move(other.clusterBatch)), samplerTables(std::move(other.samplerTables))
+    {
+        other.clear();
+    }
+    Mesh &operator=(Mesh &&other) noexcept
+    {
+        if (this != &other)
+        {
+            // the range this mesh held would leak otherwise
+            Release();
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            textures = std::move(other.textures);
+            positions = std::move(other.positions);
+            glslIdentifierPrefix = std::move(other.glslIdentifierPrefix);
+            VAO = other.VAO;
+            indexCount = other.indexCount;
+            vertexFormat = other.vertexFormat;
+            vertexBufferBytes = other.vertexBufferBytes;
+            indexType = other.indexType;
+            indexBufferBytes = other.indexBufferBytes;
+            lods = std::move(other.lods);
+            boundsCenter = other.boundsCenter;
+            boundsRadius = other.boundsRadius;
+            clusters = std::move(other.clusters);
+            arena = other.arena;
+            allocation = other.allocation;
+            clusterBatch = std::move(other.clusterBatch);
+            samplerTables = std::move(other.samplerTables);
+            other.clear();
+        }
+        return *this;
+    }
+
+    // sets the levels of detail stored in the index buffer, level 0 becomes what Draw() renders by default
+    void SetLods(vector<MeshLod> levels)
+    {
+        if (levels.empty())
+            return;
+        lods = std::move(levels);
+        indexCount = lods[0].indexCount;
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    unsigned int LodCount() const { return (unsigned int)lods.size(); }
+
+    // render the mesh, at the given level of detail
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        bindTextures(shader);
+
+        // draw mesh
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        const GeometryRange &range = arena->Range(allocation);
+        GLState::Instance().BindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, indexType, (void*)((range.firstIndex + level.indexOffset) * indexSize()),
+                                 (GLint)range.baseVertex);
+        RenderStats::Frame().triangles += level.indexCount / 3;
+        RenderStats::Frame().drawCalls++;
+        // the VAO and active texture unit are left as they are: every draw binds its own, so resetting them only costs calls
+    }
+
+    // the VAO instanced draws of this mesh use, shared by the arena; InstanceBuffer::Attach() it before DrawInstanced()
+    GLuint InstancedVAO() const { return arena ? arena->InstancedVAO() : 0; }
+
+    // renders instanceCount copies of the mesh in one call from InstancedVAO(), which needs instance attributes
+    void DrawInstanced(Shader &shader, GLsizei instanceCount, unsigned int lod = 0)
     {
-        // bind appropriate textures
+        bindTextures(shader);
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        const GeometryRange &range = arena->Range(allocation);
+        GLState::Instance().BindVertexArray(InstancedVAO());
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, indexType, (void*)((range.firstIndex + level.indexOffset) * indexSize()),
+                                          instanceCount, (GLint)range.baseVertex);
+        RenderStats::Frame().triangles += (unsigned long long)(level.indexCount / 3) * instanceCount;
+        RenderStats::Frame().drawCalls++;
+    }
+
+    // renders the clusters of level 0 that are inside the frustum and not facing away from the viewer, in one call.
+    // planes and viewer are in the object space of the mesh (see ExtractFrustumPlanes). Falls back to Draw() without clusters.
+    void DrawClusters(Shader &shader, const glm::vec4 planes[6], const glm::vec3 &viewer)
+    {
+        if (clusters.empty())
+        {
+            Draw(shader);
+            return;
+        }
+        clusterBatch.Clear();
+        AppendClusters(clusterBatch, planes, viewer);
+        if (clusterBatch.Empty())
+            return;
+        bindTextures(shader);
+        submitBatch(clusterBatch);
+    }
+
+    // appends what Draw(shader, lod) would draw to a batch
+    void AppendLod(MultiDrawBatch &batch, unsigned int lod) const
+    {
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        appendRange(batch, level.indexOffset, level.indexCount);
+        batch.triangles += level.indexCount / 3;
+    }
+
+    // appends what DrawClusters() would draw to a batch: the visible clusters, consecutive survivors merged into one range
+    void AppendClusters(MultiDrawBatch &batch, const glm::vec4 planes[6], const glm::vec3 &viewer) const
+    {
+        if (clusters.empty())
+        {
+            AppendLod(batch, 0);
+            return;
+        }
+        unsigned int drawn = 0;
+        uint32_t rangeBegin = 0, rangeEnd = 0;
+        for (const MeshCluster &cluster : clusters)
+        {
+            if (!SphereInFrustum(planes, cluster.center, cluster.radius) || ClusterFacesAway(cluster, viewer))
+                continue;
+            if (drawn > 0 && cluster.indexOffset == rangeEnd)
+                rangeEnd += cluster.indexCount;
+            else
+            {
+                if (drawn > 0)
+                    appendRange(batch, rangeBegin, rangeEnd - rangeBegin);
+                rangeBegin = cluster.indexOffset;
+                rangeEnd = cluster.indexOffset + cluster.indexCount;
+            }
+            batch.triangles += cluster.indexCount / 3;
+            drawn++;
+        }
+        if (drawn > 0)
+            appendRange(batch, rangeBegin, rangeEnd - rangeBegin);
+        RenderStats &stats = RenderStats::Frame();
+        stats.clustersDrawn += drawn;
+        stats.clustersCulled += (unsigned int)clusters.size() - drawn;
+    }
+
+    // whether a batch of the two meshes can be drawn with the textures of either: same arena and the same textures
+    // under the same sampler names
+    bool SharesBatchWith(const Mesh &other) const
+    {
+        if (arena != other.arena || glslIdentifierPrefix != other.glslIdentifierPrefix || textures.size() != other.textures.size())
+            return false;
+        for (size_t i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type)
+                return false;
+        return true;
+    }
+
+    // binds the textures of this mesh and draws the batch, which must only hold ranges of meshes it SharesBatchWith()
+    void DrawBatch(Shader &shader, const MultiDrawBatch &batch)
+    {
+        bindTextures(shader);
+        submitBatch(batch);
+    }
+
+    // drops the CPU-side geometry the policy does not keep. The memory is freed, not just cleared.
+    void Retain(GeometryRetention policy)
+    {
+        if (policy == GeometryRetention::Keep)
+            return;
+        if (policy == GeometryRetention::Compact)
+        {
+            positions = ExtractPositions(vertices.data(), vertices.size());
+        }
+        else
+        {
+            vector<glm::vec3>().swap(positions);
+            vector<unsigned int>().swap(indices);
+        }
+        vector<Vertex>().swap(vertices);
+    }
+
+    // bytes of geometry held in CPU memory
+    size_t CpuGeometryBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + positions.capacity() * sizeof(glm::vec3) + indices.capacity() * sizeof(unsigned int);
+    }
+
+    // returns the geometry of the mesh to its arena. It must not be drawn afterwards; releasing it again does nothing.
+    void Release()
+    {
+        if (arena)
+            arena->Free(allocation);
+        arena = nullptr;
+        VAO = 0;
+    }
+
+private:
+    // render data
+    GeometryArena *arena = nullptr;
+    uint32_t allocation = 0;
+    // scratch batch of DrawClusters(), kept to avoid allocating every frame
+    MultiDrawBatch clusterBatch;
+
+    // leaves a moved-from mesh without geometry, so it neither draws nor frees the range it gave away
+    void clear()
+    {
+        arena = nullptr;
+        allocation = 0;
+        VAO = 0;
+        indexCount = 0;
+        vertexBufferBytes = indexBufferBytes = 0;
+    }
+
+    void appendRange(MultiDrawBatch &batch, uint32_t indexOffset, uint32_t count) const
+    {
+        const GeometryRange &range = arena->Range(allocation);
+        batch.counts.push_back((GLsizei)count);
+        batch.offsets.push_back((const void*)((range.firstIndex + indexOffset) * indexSize()));
+        batch.baseVertices.push_back((GLint)range.baseVertex);
+    }
+
+    void submitBatch(const MultiDrawBatch &batch)
+    {
+        GLState::Instance().BindVertexArray(VAO);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), indexType, batch.offsets.data(), (GLsizei)batch.counts.size(),
+                                      batch.baseVertices.data());
+        RenderStats::Frame().triangles += batch.triangles;
+        RenderStats::Frame().drawCalls++;
+    }
+
+    // texture unit and sampler location of one texture, for one program
+    struct SamplerBinding
+    {
+        GLint location;         // -1 when the program has no sampler of that name
+        GLuint unit;
+        unsigned int texture;
+    };
+    // the bindings of all textures for one (shader, identifier prefix) pair, built the first time the mesh is drawn with it
+    struct SamplerTable
+    {
+        GLuint program;
+        std::string prefix;
+        vector<SamplerBinding> bindings;
+    };
+    vector<SamplerTable> samplerTables;   // usually one entry, one per shader the mesh is drawn with
+
+    // the only place the sampler names are formatted and looked up, once per (mesh, shader)
+    const SamplerTable &samplerTable(Shader &shader)
+    {
+        for (const SamplerTable &table : samplerTables)
+            if (table.program == shader.ID && table.prefix == glslIdentifierPrefix)
+                return table;
+        SamplerTable table;
+        table.program = shader.ID;
+        table.prefix = glslIdentifierPrefix;
+        table.bindings.reserve(textures.size());
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -75,65 +421,91 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            table.bindings.push_back({shader.UniformLocation(glslIdentifierPrefix + name + number), i, textures[i].id});
         }
+        samplerTables.push_back(std::move(table));
+        return samplerTables.back();
+    }
 
+    // binds the textures to consecutive units and points the samplers named after their type at them.
+    // the sampler is set on every draw, other meshes drawn with the same program may use other units for it.
+    void bindTextures(Shader &shader)
+    {
+        for (const SamplerBinding &binding : samplerTable(shader).bindings)
+        {
+            if (binding.location >= 0)
+                glUniform1i(binding.location, (GLint)binding.unit);
+            GLState::Instance().BindTexture(binding.unit, GL_TEXTURE_2D, binding.texture);
+        }
+    }
 
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    size_t indexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // a sphere around the bounding box, cheap and good enough to estimate the size on screen
+    void computeBoundingSphere(const Vertex *vertexData, size_t vertexCount)
+    {
+        if (vertexCount == 0)
+            return;
+        glm::vec3 minimum = vertexData[0].Position, maximum = vertexData[0].Position;
+        for (size_t i = 1; i < vertexCount; i++)
+        {
+            minimum = glm::min(minimum, vertexData[i].Position);
+            maximum = glm::max(maximum, vertexData[i].Position);
+        }
+        boundsCenter = (minimum + maximum) * 0.5f;
+        boundsRadius = glm::length(maximum - boundsCenter);
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // initializes all the buffer objects/arrays. The full-float vertices are converted to the requested GPU layout first
+    // and the attribute pointers are set up to match it.
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, VertexFormat format)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        this->indexCount = indexCount;
+        this->lods.assign(1, MeshLod{0, (uint32_t)indexCount, 0.0f});
+        this->vertexFormat = format;
+        computeBoundingSphere(vertexData, vertexCount);
+        this->vertexBufferBytes = vertexCount * VertexStride(format);
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        // convert the vertices into the GPU layout.
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        vector<PackedVertex> packed;
+        vector<glm::vec3> positions;
+        const void *gpuVertices = vertexData;
+        if (format == VertexFormat::Packed)
+        {
+            packed = PackVertices(vertexData, vertexCount);
+            gpuVertices = packed.data();
+        }
+        else if (format == VertexFormat::PositionOnly)
+        {
+            positions = ExtractPositions(vertexData, vertexCount);
+            gpuVertices = positions.data();
+        }
+        // the indices are relative to the first vertex of the mesh, so every mesh small enough gets 16-bit ones
+        // (half the index bandwidth and memory) whatever its place in the arena
+        vector<unsigned short> shortIndices;
+        const void *gpuIndices = indexData;
+        if (vertexCount <= 65536)
+        {
+            shortIndices.assign(indexData, indexData + indexCount);
+            gpuIndices = shortIndices.data();
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+        }
+        indexBufferBytes = indexCount * indexSize();
+
+        // suballocate the geometry from the arena of its layout, which shares one VAO between all its meshes
+        arena = &GeometryArena::For(format, indexType);
+        allocation = arena->Allocate(gpuVertices, (uint32_t)vertexCount, gpuIndices, (uint32_t)indexCount);
+        VAO = arena->VAO();
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,287 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/mapped_file.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// bump whenever the on-disk layout, the Vertex struct or the import-time processing changes, old cache files are then ignored and rebuilt.
+// 2: meshes are stored welded and reordered (mesh_optimizer.h)
+// 3: index blobs hold all levels of detail, described by a MeshLod table per mesh
+// 4: MeshCluster table per mesh
+const uint32_t MESH_CACHE_VERSION = 4;
+
+// on-disk layout of a .meshcache file:
+//   MeshCacheHeader
+//   source path (sourcePathLength bytes, padded to 16)
+//   MeshCacheRecord[meshCount]
+//   per mesh: texture references, LOD table, cluster table, vertex blob and index blob, each blob aligned to 16 bytes
+struct MeshCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t vertexStride;
+    uint32_t meshCount;
+    uint64_t sourceSize;
+    int64_t  sourceMtime;
+    uint64_t sourceHash;
+    uint64_t coldLoadMicros; // how long the Assimp import took when the cache was built, used for reporting
+    uint32_t sourcePathLength;
+    uint32_t reserved;
+};
+
+struct MeshCacheRecord
+{
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t clusterCount;
+    uint32_t reserved;
+    uint64_t textureOffset;
+    uint64_t lodOffset;
+    uint64_t clusterOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+};
+
+class MeshCache
+{
+public:
+    vector<MeshData> meshes; // geometry points straight into the mapped file
+    uint64_t coldLoadMicros = 0;
+
+    static string CachePathFor(const string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // maps the cache for the given source asset. Returns false if there is no cache yet or if it is stale
+    // (different source size, mtime, content, import flags, vertex layout or cache version).
+    bool Open(const string &sourcePath, unsigned int importFlags)
+    {
+        meshes.clear();
+        SourceKey key;
+        if (!readSourceKey(sourcePath, key))
+            return false;
+        if (!file.Open(CachePathFor(sourcePath)))
+            return false;
+
+        if (!parse(sourcePath, importFlags, key))
+        {
+            meshes.clear();
+            file.Close();
+            return false;
+        }
+        return true;
+    }
+
+    // releases the mapping. The geometry pointers of meshes are invalid afterwards.
+    void Close()
+    {
+        meshes.clear();
+        file.Close();
+    }
+
+    // writes the GPU-ready vertex/index data and texture references of already processed meshes.
+    static bool Write(const string &sourcePath, unsigned int importFlags, const vector<MeshData> &meshes, uint64_t coldLoadMicros)
+    {
+        SourceKey key;
+        if (!readSourceKey(sourcePath, key))
+            return false;
+
+        MeshCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "LOGLMSH", 8);
+        header.version = MESH_CACHE_VERSION;
+        header.importFlags = importFlags;
+        header.vertexStride = sizeof(Vertex);
+        header.meshCount = (uint32_t)meshes.size();
+        header.sourceSize = key.size;
+        header.sourceMtime = key.mtime;
+        header.sourceHash = key.hash;
+        header.coldLoadMicros = coldLoadMicros;
+        header.sourcePathLength = (uint32_t)sourcePath.size();
+
+        vector<unsigned char> out;
+        append(out, &header, sizeof(header));
+        append(out, sourcePath.data(), sourcePath.size());
+        align(out);
+
+        size_t recordsOffset = out.size();
+        out.resize(out.size() + meshes.size() * sizeof(MeshCacheRecord));
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            MeshCacheRecord record;
+            memset(&record, 0, sizeof(record));
+            record.vertexCount = mesh.VertexCount();
+            record.indexCount = mesh.IndexCount();
+            record.textureCount = (uint32_t)mesh.textures.size();
+
+            record.textureOffset = out.size();
+            for (const TextureRef &texture : mesh.textures)
+            {
+                appendString(out, texture.type);
+                appendString(out, texture.path);
+            }
+            align(out);
+            record.lodCount = (uint32_t)mesh.lods.size();
+            record.lodOffset = out.size();
+            append(out, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+            align(out);
+            record.clusterCount = (uint32_t)mesh.clusters.size();
+            record.clusterOffset = out.size();
+            append(out, mesh.clusters.data(), mesh.clusters.size() * sizeof(MeshCluster));
+            align(out);
+            record.vertexOffset = out.size();
+            append(out, mesh.VertexData(), record.vertexCount * sizeof(Vertex));
+            align(out);
+            record.indexOffset = out.size();
+            append(out, mesh.IndexData(), record.indexCount * sizeof(unsigned int));
+            align(out);
+
+            memcpy(&out[recordsOffset + i * sizeof(MeshCacheRecord)], &record, sizeof(record));
+        }
+
+        // write next to the final file and rename, so a crash never leaves a half written cache behind
+        string cachePath = CachePathFor(sourcePath);
+        string tmpPath = cachePath + ".tmp";
+        FILE *f = fopen(tmpPath.c_str(), "wb");
+        if (!f)
+            return false;
+        bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+        ok = fclose(f) == 0 && ok;
+        if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct SourceKey
+    {
+        uint64_t size;
+        int64_t  mtime;
+        uint64_t hash;
+    };
+
+    MappedFile file;
+
+    static bool readSourceKey(const string &sourcePath, SourceKey &key)
+    {
+        AssetData source;
+        if (!StatAsset(sourcePath, key.size, key.mtime) || !source.Open(sourcePath))
+            return false;
+        key.hash = HashBytes(source.Data(), source.Size());
+        return true;
+    }
+
+    static void append(vector<unsigned char> &out, const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    static void appendString(vector<unsigned char> &out, const string &s)
+    {
+        uint32_t length = (uint32_t)s.size();
+        append(out, &length, sizeof(length));
+        append(out, s.data(), s.size());
+    }
+
+    static void align(vector<unsigned char> &out)
+    {
+        out.resize((out.size() + 15) & ~(size_t)15, 0);
+    }
+
+    bool inBounds(uint64_t offset, uint64_t size) const
+    {
+        return offset <= file.Size() && size <= file.Size() - offset;
+    }
+
+    bool readString(uint64_t &offset, string &s) const
+    {
+        uint32_t length;
+        if (!inBounds(offset, sizeof(length)))
+            return false;
+        memcpy(&length, file.Data() + offset, sizeof(length));
+        offset += sizeof(length);
+        if (!inBounds(offset, length))
+            return false;
+        s.assign(reinterpret_cast<const char *>(file.Data() + offset), length);
+        offset += length;
+        return true;
+    }
+
+    bool parse(const string &sourcePath, unsigned int importFlags, const SourceKey &key)
+    {
+        MeshCacheHeader header;
+        if (!inBounds(0, sizeof(header)))
+            return false;
+        memcpy(&header, file.Data(), sizeof(header));
+        if (memcmp(header.magic, "LOGLMSH", 8) != 0 || header.version != MESH_CACHE_VERSION ||
+            header.importFlags != importFlags || header.vertexStride != sizeof(Vertex) ||
+            header.sourceSize != key.size || header.sourceMtime != key.mtime || header.sourceHash != key.hash)
+            return false;
+        if (!inBounds(sizeof(header), header.sourcePathLength) ||
+            sourcePath.compare(0, string::npos, reinterpret_cast<const char *>(file.Data() + sizeof(header)), header.sourcePathLength) != 0)
+            return false;
+        coldLoadMicros = header.coldLoadMicros;
+
+        uint64_t recordsOffset = (sizeof(header) + header.sourcePathLength + 15) & ~(uint64_t)15;
+        if (!inBounds(recordsOffset, (uint64_t)header.meshCount * sizeof(MeshCacheRecord)))
+            return false;
+
+        meshes.reserve(header.meshCount);
+        for (unsigned int i = 0; i < header.meshCount; i++)
+        {
+            MeshCacheRecord record;
+            memcpy(&record, file.Data() + recordsOffset + i * sizeof(MeshCacheRecord), sizeof(record));
+            if (!inBounds(record.vertexOffset, (uint64_t)record.vertexCount * sizeof(Vertex)) ||
+                !inBounds(record.indexOffset, (uint64_t)record.indexCount * sizeof(unsigned int)) ||
+                !inBounds(record.lodOffset, (uint64_t)record.lodCount * sizeof(MeshLod)) ||
+                !inBounds(record.clusterOffset, (uint64_t)record.clusterCount * sizeof(MeshCluster)))
+                return false;
+
+            MeshData mesh;
+            mesh.vertexData = reinterpret_cast<const Vertex *>(file.Data() + record.vertexOffset);
+            mesh.vertexCount = record.vertexCount;
+            mesh.indexData = reinterpret_cast<const unsigned int *>(file.Data() + record.indexOffset);
+            mesh.indexCount = record.indexCount;
+            mesh.lods.resize(record.lodCount);
+            if (record.lodCount > 0)
+                memcpy(mesh.lods.data(), file.Data() + record.lodOffset, record.lodCount * sizeof(MeshLod));
+            for (const MeshLod &lod : mesh.lods)
+                if ((uint64_t)lod.indexOffset + lod.indexCount > record.indexCount)
+                    return false;
+            mesh.clusters.resize(record.clusterCount);
+            if (record.clusterCount > 0)
+                memcpy(mesh.clusters.data(), file.Data() + record.clusterOffset, record.clusterCount * sizeof(MeshCluster));
+            for (const MeshCluster &cluster : mesh.clusters)
+                if ((uint64_t)cluster.indexOffset + cluster.indexCount > record.indexCount)
+                    return false;
+            uint64_t offset = record.textureOffset;
+            for (unsigned int t = 0; t < record.textureCount; t++)
+            {
+                TextureRef texture;
+                if (!readString(offset, texture.type) || !readString(offset, texture.path))
+                    return false;
+                mesh.textures.push_back(texture);
+            }
+            meshes.push_back(std::move(mesh));
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef MESH_CLUSTERS_H
+#define MESH_CLUSTERS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// meshlets: a mesh's index buffer split into small consecutive runs of triangles, each with a bounding sphere and a
+// normal cone, so the CPU can skip the parts of a large mesh that are outside the view or facing away from it.
+// the runs follow the vertex cache order from mesh_optimizer.h, so building them does not reorder anything.
+
+const unsigned int MESH_CLUSTER_MAX_VERTICES = 64;
+const unsigned int MESH_CLUSTER_MAX_TRIANGLES = 124;
+// smaller meshes are drawn with a single call, splitting them would cost more than culling saves
+const unsigned int MESH_CLUSTER_MIN_TRIANGLES = 4 * MESH_CLUSTER_MAX_TRIANGLES;
+
+struct MeshCluster {
+    uint32_t  indexOffset;
+    uint32_t  indexCount;
+    glm::vec3 center;       // object space bounding sphere
+    float     radius;
+    glm::vec3 coneAxis;     // average facing of the triangles
+    float     coneCutoff;   // sine of the largest angle between a triangle normal and the axis, > 1 if the cone is wider than 90 degrees
+};
+
+// splits indices[indexOffset, indexOffset + indexCount) into clusters of at most MESH_CLUSTER_MAX_VERTICES unique vertices
+// and MESH_CLUSTER_MAX_TRIANGLES triangles
+inline std::vector<MeshCluster> BuildClusters(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                              uint32_t indexOffset, uint32_t indexCount)
+{
+    std::vector<MeshCluster> clusters;
+    if (indexCount / 3 < MESH_CLUSTER_MIN_TRIANGLES)
+        return clusters;
+
+    std::vector<unsigned int> stamp(vertices.size(), ~0u);  // cluster that last counted the vertex
+    auto finish = [&](uint32_t begin, uint32_t end) {
+        MeshCluster cluster;
+        cluster.indexOffset = begin;
+        cluster.indexCount = end - begin;
+
+        glm::vec3 minimum = vertices[indices[begin]].Position, maximum = minimum;
+        glm::vec3 normalSum(0.0f);
+        for (uint32_t i = begin; i < end; i += 3)
+        {
+            const glm::vec3 &p0 = vertices[indices[i]].Position;
+            const glm::vec3 &p1 = vertices[indices[i + 1]].Position;
+            const glm::vec3 &p2 = vertices[indices[i + 2]].Position;
+            minimum = glm::min(minimum, glm::min(p0, glm::min(p1, p2)));
+            maximum = glm::max(maximum, glm::max(p0, glm::max(p1, p2)));
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+                normalSum += normal * (1.0f / length);
+        }
+        cluster.center = (minimum + maximum) * 0.5f;
+        cluster.radius = 0.0f;
+        for (uint32_t i = begin; i < end; i++)
+            cluster.radius = std::max(cluster.radius, glm::length(vertices[indices[i]].Position - cluster.center));
+
+        // the cone is as wide as the triangle that deviates most from the average facing
+        float axisLength = glm::length(normalSum);
+        cluster.coneAxis = axisLength > 0.0f ? normalSum * (1.0f / axisLength) : glm::vec3(0.0f, 0.0f, 1.0f);
+        float minimumDot = axisLength > 0.0f ? 1.0f : -1.0f;
+        for (uint32_t i = begin; i < end && minimumDot > 0.0f; i += 3)
+        {
+            const glm::vec3 &p0 = vertices[indices[i]].Position;
+            glm::vec3 normal = glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+                minimumDot = std::min(minimumDot, glm::dot(normal, cluster.coneAxis) / length);
+        }
+        cluster.coneCutoff = minimumDot > 0.0f ? std::sqrt(1.0f - minimumDot * minimumDot) : 2.0f;
+        clusters.push_back(cluster);
+    };
+
+    uint32_t begin = indexOffset;
+    unsigned int clusterVertices = 0;
+    for (uint32_t i = indexOffset; i + 2 < indexOffset + indexCount; i += 3)
+    {
+        unsigned int id = (unsigned int)clusters.size();
+        unsigned int added = 0;
+        for (unsigned int k = 0; k < 3; k++)
+            added += stamp[indices[i + k]] != id;
+        if (clusterVertices + added > MESH_CLUSTER_MAX_VERTICES || (i - begin) / 3 == MESH_CLUSTER_MAX_TRIANGLES)
+        {
+            finish(begin, i);
+            begin = i;
+            clusterVertices = 0;
+            id++;
+        }
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            if (stamp[indices[i + k]] != id)
+            {
+                stamp[indices[i + k]] = id;
+                clusterVertices++;
+            }
+        }
+    }
+    if (begin < indexOffset + indexCount)
+        finish(begin, indexOffset + indexCount);
+    return clusters;
+}
+
+// the six planes (a, b, c, d) of the view frustum of a clip matrix, normalized, pointing inwards.
+// planes of projection * view * model are in the object space of the model.
+inline void ExtractFrustumPlanes(const glm::mat4 &clip, glm::vec4 planes[6])
+{
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+    planes[0] = rows[3] + rows[0];  // left
+    planes[1] = rows[3] - rows[0];  // right
+    planes[2] = rows[3] + rows[1];  // bottom
+    planes[3] = rows[3] - rows[1];  // top
+    planes[4] = rows[3] + rows[2];  // near
+    planes[5] = rows[3] - rows[2];  // far
+    for (int p = 0; p < 6; p++)
+    {
+        float length = glm::length(glm::vec3(planes[p]));
+        if (length > 0.0f)
+            planes[p] = planes[p] * (1.0f / length);
+    }
+}
+
+inline bool SphereInFrustum(const glm::vec4 planes[6], const glm::vec3 &center, float radius)
+{
+    for (int p = 0; p < 6; p++)
+        if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+            return false;
+    return true;
+}
+
+// true if every triangle of the cluster faces away from the viewer. viewer is in the same space as the cluster, which
+// must not be scaled non-uniformly relative to world space for the angles to hold.
+inline bool ClusterFacesAway(const MeshCluster &cluster, const glm::vec3 &viewer)
+{
+    glm::vec3 toCluster = cluster.center - viewer;
+    return glm::dot(toCluster, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCluster) + cluster.radius;
+}
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// import-time level of detail generation, GL-free so it runs on the import workers.
+// the LODs are extra index buffers over the vertices of the original mesh: simplification collapses vertices onto
+// neighbouring vertices (half-edge collapses ordered by quadric error, Garland & Heckbert 1997), so no new vertices
+// are created and all levels share one vertex buffer.
+
+// levels per mesh, including the original
+const unsigned int MESH_LOD_COUNT = 4;
+// meshes with fewer triangles are not simplified any further
+const unsigned int MESH_LOD_MIN_TRIANGLES = 64;
+
+// one level of detail: a range of the mesh's index buffer and how far (object space) its surface may be from the original
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float    error;
+};
+
+namespace qem {
+
+// symmetric 4x4 matrix, the sum of squared distances to a set of planes
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+
+    static Quadric FromPlane(double nx, double ny, double nz, double d)
+    {
+        Quadric q;
+        q.a00 = nx * nx; q.a01 = nx * ny; q.a02 = nx * nz; q.a03 = nx * d;
+        q.a11 = ny * ny; q.a12 = ny * nz; q.a13 = ny * d;
+        q.a22 = nz * nz; q.a23 = nz * d;
+        q.a33 = d * d;
+        return q;
+    }
+
+    void Add(const Quadric &o)
+    {
+        a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03; a11 += o.a11;
+        a12 += o.a12; a13 += o.a13; a22 += o.a22; a23 += o.a23; a33 += o.a33;
+    }
+
+    double Evaluate(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                 + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                 + a22 * z * z + 2 * a23 * z + a33;
+        return e > 0.0 ? e : 0.0;
+    }
+};
+
+struct Collapse {
+    double cost;
+    unsigned int from;  // position group that disappears
+    unsigned int to;    // position group it is moved onto
+    bool operator<(const Collapse &o) const { return cost > o.cost; }   // min-heap
+};
+
+// vertices that share a position (UV or normal seams) form one group. Collapses work on groups so seams do not crack.
+inline std::vector<unsigned int> GroupPositions(const std::vector<Vertex> &vertices, unsigned int &groupCount)
+{
+    size_t tableSize = 1;
+    while (tableSize < vertices.size() * 2)
+        tableSize <<= 1;
+    const unsigned int empty = ~0u;
+    std::vector<unsigned int> table(tableSize, empty);  // holds a representative vertex per group
+    std::vector<unsigned int> groups(vertices.size());
+    std::vector<unsigned int> groupOfRepresentative(vertices.size(), empty);
+    groupCount = 0;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        size_t slot = HashBytes(&vertices[i].Position, sizeof(glm::vec3)) & (tableSize - 1);
+        while (table[slot] != empty && std::memcmp(&vertices[table[slot]].Position, &vertices[i].Position, sizeof(glm::vec3)) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] == empty)
+        {
+            table[slot] = (unsigned int)i;
+            groupOfRepresentative[i] = groupCount++;
+        }
+        groups[i] = groupOfRepresentative[table[slot]];
+    }
+    return groups;
+}
+
+inline glm::vec3 TriangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+} // namespace qem
+
+// simplifies the triangles in indices down to about targetIndexCount indices, or as far as possible without moving
+// locked vertices. Vertices on open borders and on attribute seams are locked, so the silhouette and the texture
+// layout survive. Returns the new index buffer, error receives the largest collapse error as an object-space distance.
+inline std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                              size_t targetIndexCount, float &error)
+{
+    using namespace qem;
+    error = 0.0f;
+    size_t triangleCount = indices.size() / 3;
+    unsigned int groupCount = 0;
+    std::vector<unsigned int> groupOf = GroupPositions(vertices, groupCount);
+
+    // a group can only be collapsed away if all its triangles use the same vertex for it
+    std::vector<unsigned int> groupVertex(groupCount, ~0u);
+    std::vector<bool> locked(groupCount, false);
+    for (unsigned int index : indices)
+    {
+        unsigned int group = groupOf[index];
+        if (groupVertex[group] == ~0u)
+            groupVertex[group] = index;
+        else if (groupVertex[group] != index)
+            locked[group] = true;   // seam
+    }
+
+    // border edges are used by a single triangle
+    std::unordered_map<uint64_t, unsigned int> edgeUse;
+    edgeUse.reserve(indices.size());
+    auto edgeKey = [](unsigned int a, unsigned int b) { return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a; };
+    for (size_t t = 0; t < triangleCount; t++)
+        for (unsigned int k = 0; k < 3; k++)
+            edgeUse[edgeKey(groupOf[indices[t * 3 + k]], groupOf[indices[t * 3 + (k + 1) % 3]])]++;
+    for (const auto &edge : edgeUse)
+        if (edge.second != 2)
+        {
+            locked[edge.first >> 32] = true;
+            locked[edge.first & 0xffffffffu] = true;
+        }
+
+    // per group: the plane quadrics of its triangles and the triangles around it
+    std::vector<Quadric> quadrics(groupCount);
+    std::vector<std::vector<unsigned int>> around(groupCount);
+    std::vector<unsigned int> corners(indices);     // current vertex of every triangle corner
+    std::vector<bool> alive(triangleCount, true);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 &p0 = vertices[corners[t * 3]].Position;
+        glm::vec3 normal = TriangleNormal(p0, vertices[corners[t * 3 + 1]].Position, vertices[corners[t * 3 + 2]].Position);
+        double length = std::sqrt((double)glm::dot(normal, normal));
+        if (length > 0.0)
+        {
+            double nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+            Quadric plane = Quadric::FromPlane(nx, ny, nz, -(nx * p0.x + ny * p0.y + nz * p0.z));
+            for (unsigned int k = 0; k < 3; k++)
+                quadrics[groupOf[corners[t * 3 + k]]].Add(plane);
+        }
+        for (unsigned int k = 0; k < 3; k++)
+            around[groupOf[corners[t * 3 + k]]].push_back((unsigned int)t);
+    }
+
+    auto position = [&](unsigned int group) -> const glm::vec3 & { return vertices[groupVertex[group]].Position; };
+    auto cost = [&](unsigned int from, unsigned int to) {
+        Quadric q = quadrics[from];
+        q.Add(quadrics[to]);
+        return q.Evaluate(position(to));
+    };
+    std::priority_queue<Collapse> queue;
+    auto pushEdges = [&](unsigned int t) {
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            unsigned int a = groupOf[corners[t * 3 + k]];
+            unsigned int b = groupOf[corners[t * 3 + (k + 1) % 3]];
+            if (!locked[a])
+                queue.push({cost(a, b), a, b});
+            if (!locked[b])
+                queue.push({cost(b, a), b, a});
+        }
+    };
+    for (size_t t = 0; t < triangleCount; t++)
+        pushEdges((unsigned int)t);
+
+    std::vector<bool> removed(groupCount, false);
+    size_t liveTriangles = triangleCount;
+    double maxCost = 0.0;
+    while (liveTriangles * 3 > targetIndexCount && !queue.empty())
+    {
+        Collapse collapse = queue.top();
+        queue.pop();
+        unsigned int from = collapse.from, to = collapse.to;
+        if (removed[from] || removed[to])
+            continue;
+        double current = cost(from, to);
+        if (current > collapse.cost * 1.0001 + 1e-12)
+        {
+            // the quadrics grew since this entry was queued
+            queue.push({current, from, to});
+            continue;
+        }
+
+        // the two must still share an edge, and moving 'from' onto 'to' must not flip any remaining triangle
+        bool adjacent = false;
+        bool flips = false;
+        // the vertex 'from' moves onto. 'to' may be a locked seam group with one vertex per UV/normal chart, and the
+        // triangles on the collapsed edge are on the chart of 'from', so their corner of 'to' is the right one
+        unsigned int toVertex = groupVertex[to];
+        const glm::vec3 &target = position(to);
+        for (unsigned int t : around[from])
+        {
+            if (!alive[t])
+                continue;
+            unsigned int g[3] = {groupOf[corners[t * 3]], groupOf[corners[t * 3 + 1]], groupOf[corners[t * 3 + 2]]};
+            if (g[0] == to || g[1] == to || g[2] == to)
+            {
+                if (!adjacent)
+                    toVertex = corners[t * 3 + (g[0] == to ? 0 : g[1] == to ? 1 : 2)];
+                adjacent = true;
+                continue;
+            }
+            glm::vec3 p[3] = {vertices[corners[t * 3]].Position, vertices[corners[t * 3 + 1]].Position, vertices[corners[t * 3 + 2]].Position};
+            glm::vec3 before = TriangleNormal(p[0], p[1], p[2]);
+            for (unsigned int k = 0; k < 3; k++)
+                if (g[k] == from)
+                    p[k] = target;
+            glm::vec3 after = TriangleNormal(p[0], p[1], p[2]);
+            if (glm::dot(before, after) <= 0.0f)
+            {
+                flips = true;
+                break;
+            }
+        }
+        if (!adjacent || flips)
+            continue;
+
+        // the triangles on the collapsed edge disappear, the others take over the vertex of 'to'
+        for (unsigned int t : around[from])
+        {
+            if (!alive[t])
+                continue;
+            bool onEdge = false;
+            for (unsigned int k = 0; k < 3; k++)
+                onEdge = onEdge || groupOf[corners[t * 3 + k]] == to;
+            if (onEdge)
+            {
+                alive[t] = false;
+                liveTriangles--;
+                continue;
+            }
+            for (unsigned int k = 0; k < 3; k++)
+                if (groupOf[corners[t * 3 + k]] == from)
+                    corners[t * 3 + k] = toVertex;
+            around[to].push_back(t);
+        }
+        quadrics[to].Add(quadrics[from]);
+        removed[from] = true;
+        std::vector<unsigned int>().swap(around[from]);
+        maxCost = std::max(maxCost, current);
+        // only the edges of 'to' changed their cost, and the neighbours of 'from' are now connected to it.
+        // dead triangles are dropped from its list on the way
+        std::vector<unsigned int> &triangles = around[to];
+        size_t kept = 0;
+        for (unsigned int t : triangles)
+        {
+            if (!alive[t])
+                continue;
+            triangles[kept++] = t;
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int other = groupOf[corners[t * 3 + k]];
+                if (other == to)
+                    continue;
+                if (!locked[to])
+                    queue.push({cost(to, other), to, other});
+                if (!locked[other])
+                    queue.push({cost(other, to), other, to});
+            }
+        }
+        triangles.resize(kept);
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+        if (alive[t])
+            result.insert(result.end(), &corners[t * 3], &corners[t * 3] + 3);
+    error = (float)std::sqrt(maxCost);
+    return result;
+}
+
+// appends up to MESH_LOD_COUNT - 1 simplified index buffers, each about half the triangles of the one before, to indices
+// and returns the ranges of all levels. Level 0 is the index buffer as it was passed in. Stops early when a level would not
+// remove at least a fifth of the triangles (most of the mesh is locked by seams and borders).
+inline std::vector<MeshLod> GenerateLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    std::vector<MeshLod> lods(1, MeshLod{0, (uint32_t)indices.size(), 0.0f});
+    std::vector<unsigned int> source(indices);
+    float error = 0.0f;
+    for (unsigned int level = 1; level < MESH_LOD_COUNT; level++)
+    {
+        if (source.size() / 3 < MESH_LOD_MIN_TRIANGLES)
+            break;
+        float levelError = 0.0f;
+        std::vector<unsigned int> lod = SimplifyMesh(vertices, source, source.size() / 6 * 3, levelError);
+        if (lod.empty() || lod.size() * 5 > source.size() * 4)
+            break;
+        OptimizeVertexCache(lod, vertices);
+        // every level is simplified from the previous one, so the errors add up
+        error += levelError;
+        lods.push_back(MeshLod{(uint32_t)indices.size(), (uint32_t)lod.size(), error});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        source.swap(lod);
+    }
+    return lods;
+}
+
+#endif
@@ -10,18 +10,39 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/asset_pack_io.h>
+#include <learnopengl/instance_buffer.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/memory_stats.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/obj_loader.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/render_view.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/startup_trace.h>
+#include <learnopengl/texture_registry.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
 #include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <utility>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, uint64_t content = 0, size_t fileBytes = 0);
+
+// post-processing applied on import. Part of the mesh cache key, so changing it invalidates cached models.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
 
 
@@ -33,43 +54,465 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // when false, Import() always goes through ASSIMP and neither reads nor writes the mesh cache
+    bool useMeshCache = true;
+    // when true, .obj files are read by the native multi-threaded OBJ/MTL reader, ASSIMP remains the fallback
+    bool useObjLoader = true;
+    // CPU-side geometry the meshes keep after Upload(). Set before the model is uploaded.
+    GeometryRetention geometryRetention = GeometryRetention::Keep;
+    // GPU vertex layout of the meshes. Set before the model is uploaded.
+    VertexFormat vertexFormat = VertexFormat::Full;
+    // how many pixels the simplified surface may deviate from the original before a finer level of detail is drawn
+    float lodPixelError = 1.0f;
+    // object space bounds of all meshes, valid once IsImported()
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
+        Import(path);
+        Upload();
+    }
+
+    // creates an empty model, to be filled in two phases: Import() on any thread, then Upload() on the GL thread.
+    explicit Model(bool gamma = false) : gammaCorrection(gamma)
+    {
+    }
+
+    // gives back the meshes' ranges and the model's references to its textures. Deleting the last reference to a
+    // texture is a GL call, so a model that acquired textures must be released or destroyed while the context is current.
+    ~Model()
+    {
+        Release();
+    }
+
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    // CPU phase: reads the file (from the mesh cache or through ASSIMP) and converts it into MeshData.
+    // makes no GL calls, so different models can be imported concurrently.
+    void Import(string const &path)
+    {
+        TraceScope trace("model", "import " + path);
         loadModel(path);
+        hashTextures();
+        computeBounds();
+        imported.store(true, memory_order_release);
+    }
+
+    // GL phase: creates the buffers and textures of everything Import() produced. Must run on the thread owning the GL context.
+    void Upload()
+    {
+        TraceScope trace("model", "upload " + path);
+        auto start = chrono::steady_clock::now();
+        size_t residentBefore = ResidentSetBytes();
+        size_t geometryBefore = 0;
+        // build everything first and swap it in at the end, so Draw() switches from the proxy to the full model in one go
+        vector<Mesh> uploaded;
+        uploaded.reserve(pending.size());
+        for (MeshData &data : pending)
+        {
+            vector<Texture> textures;
+            textures.reserve(data.textures.size());
+            for (const TextureRef &ref : data.textures)
+                textures.push_back(loadTexture(ref));
+            // imported geometry is moved into the mesh, so the vertices allocated in processMesh() are the ones the mesh keeps.
+            // geometry in the mesh cache mapping is only copied out when the policy keeps some of it, the mapping is closed below.
+            if (!data.OwnsGeometry() && geometryRetention != GeometryRetention::Release)
+            {
+                data.vertices.assign(data.VertexData(), data.VertexData() + data.VertexCount());
+                data.indices.assign(data.IndexData(), data.IndexData() + data.IndexCount());
+                data.vertexData = nullptr;
+                data.indexData = nullptr;
+            }
+            if (data.OwnsGeometry())
+                uploaded.emplace_back(std::move(data.vertices), std::move(data.indices), std::move(textures), vertexFormat);
+            else
+                uploaded.emplace_back(data.VertexData(), data.VertexCount(), data.IndexData(), data.IndexCount(), std::move(textures), vertexFormat);
+            Mesh &mesh = uploaded.back();
+            mesh.glslIdentifierPrefix = glslIdentifierPrefix;
+            mesh.SetLods(std::move(data.lods));
+            mesh.clusters = std::move(data.clusters);
+            geometryBefore += mesh.CpuGeometryBytes();
+            mesh.Retain(geometryRetention);
+        }
+        if (meshes.empty())
+            meshes.swap(uploaded);
+        else
+            meshes.insert(meshes.end(), make_move_iterator(uploaded.begin()), make_move_iterator(uploaded.end()));
+        pending.clear();
+        cache.Close();
+        if (proxy)
+        {
+            proxy->Release();
+            proxy.reset();
+        }
+        ready = true;
+        cout << "MODEL::UPLOAD:: " << path << ": " << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1000.0 << " ms" << endl;
+        // other models may be importing at the same time, so the resident size is only indicative for a single model
+        cout << "MODEL::MEMORY:: " << path << ": CPU geometry " << BytesToMB(geometryBefore) << " MB -> " << BytesToMB(CpuGeometryBytes())
+             << " MB (" << GeometryRetentionName(geometryRetention) << "), resident " << BytesToMB(residentBefore) << " MB -> "
+             << BytesToMB(ResidentSetBytes()) << " MB" << endl;
+        size_t vertexBytes = GpuVertexBytes();
+        size_t fullBytes = vertexBytes / VertexStride(vertexFormat) * sizeof(Vertex);
+        cout << "MODEL::VERTICES:: " << path << ": " << vertexBytes / VertexStride(vertexFormat) << " vertices, " << VertexStride(vertexFormat)
+             << " B/vertex (" << VertexFormatName(vertexFormat) << "), VBOs " << BytesToMB(vertexBytes) << " MB";
+        if (vertexFormat != VertexFormat::Full && vertexBytes > 0)
+            cout << ", full layout would be " << BytesToMB(fullBytes) << " MB (" << (double)fullBytes / vertexBytes << "x)";
+        size_t indexBytes = 0;
+        unsigned int shortIndexMeshes = 0;
+        for (const Mesh &mesh : meshes)
+        {
+            indexBytes += mesh.indexBufferBytes;
+            shortIndexMeshes += mesh.indexType == GL_UNSIGNED_SHORT;
+        }
+        cout << ", IBOs " << BytesToMB(indexBytes) << " MB (" << shortIndexMeshes << "/" << meshes.size() << " meshes with 16-bit indices)" << endl;
     }
 
-    // draws the model, and thus all its meshes
+    // draws the model, and thus all its meshes. While the model is still loading in the background it draws
+    // a white box of its bounds once the import has finished, and nothing before that.
     void Draw(Shader &shader)
     {
+        if (!ready)
+        {
+            if (imported.load(memory_order_acquire))
+                proxyMesh().Draw(shader);
+            return;
+        }
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // unloads the model: the ranges of all meshes go back to their arenas for the next models to reuse and every texture
+    // it acquired is released in the TextureRegistry. The model draws nothing until it is imported and uploaded again.
+    void Release()
+    {
+        for (Mesh &mesh : meshes)
+            mesh.Release();
+        meshes.clear();
+        for (const Texture &texture : textures_loaded)
+            TextureRegistry::Instance().Release(texture.id);
+        textures_loaded.clear();
+        textureIndex.clear();
+        if (proxy)
+        {
+            proxy->Release();
+            proxy.reset();
+        }
+        ready = false;
+        imported.store(false, memory_order_release);
+    }
+
+    // bytes of vertex and index data produced by Import() and not yet uploaded
+    size_t ImportedGeometryBytes() const
+    {
+        size_t bytes = 0;
+        for (const MeshData &data : pending)
+            bytes += data.VertexCount() * sizeof(Vertex) + data.IndexCount() * sizeof(unsigned int);
+        return bytes;
+    }
+
+    // bytes of geometry the uploaded meshes hold in CPU memory
+    size_t CpuGeometryBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.CpuGeometryBytes();
+        return bytes;
+    }
+
+    // bytes of the vertex buffers of the uploaded meshes
+    size_t GpuVertexBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.vertexBufferBytes;
+        return bytes;
+    }
+
+    // draws the meshes that intersect the view frustum. Each one is drawn at the coarsest level of detail whose
+    // simplification error stays below lodPixelError pixels on screen, and at full detail large meshes only submit the
+    // clusters that are visible and facing the viewer. modelMatrix is the transform the shader draws the model with.
+    void Draw(Shader &shader, const glm::mat4 &modelMatrix, const RenderView &view)
+    {
+        if (!ready)
+        {
+            Draw(shader);
+            return;
+        }
+        forEachVisibleMesh(modelMatrix, view, [&](Mesh &mesh, unsigned int lod, const glm::vec4 *planes, const glm::vec3 &viewer) {
+            if (planes)
+                mesh.DrawClusters(shader, planes, viewer);
+            else
+                mesh.Draw(shader, lod);
+        });
+    }
+
+    // the same selection as Draw(), but the meshes go into the queue to be drawn in key order
+    void Submit(RenderQueue &queue, const DrawState &state, const glm::mat4 &modelMatrix, const RenderView &view)
+    {
+        if (!ready)
+        {
+            if (imported.load(memory_order_acquire))
+                queue.Submit(state, modelMatrix, proxyMesh(), 0);
+            return;
+        }
+        forEachVisibleMesh(modelMatrix, view, [&](Mesh &mesh, unsigned int lod, const glm::vec4 *planes, const glm::vec3 &viewer) {
+            queue.Submit(state, modelMatrix, mesh, lod, planes, viewer);
+        });
+    }
+
+    // all meshes once per instance of the buffer, in one instanced draw each. There is no per-instance culling, the
+    // caller only puts the instances it wants drawn into the buffer; center is where the batch is depth sorted.
+    void SubmitInstanced(RenderQueue &queue, const DrawState &state, InstanceBuffer &instances, const glm::vec3 &center,
+                         unsigned int lod = 0)
+    {
+        if (!ready)
+        {
+            if (imported.load(memory_order_acquire))
+                queue.SubmitInstanced(state, proxyMesh(), 0, instances, center);
+            return;
+        }
+        for (Mesh &mesh : meshes)
+            queue.SubmitInstanced(state, mesh, lod, instances, center);
+    }
+
+    bool IsImported() const { return imported.load(memory_order_acquire); }
+    bool IsReady() const { return ready; }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
+        if (proxy)
+            proxy->glslIdentifierPrefix = prefix;
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    string path;
+    string glslIdentifierPrefix;
+    vector<MeshData> pending;   // imported but not yet uploaded
+    MeshCache cache;            // keeps the mapping pending points into alive until Upload()
+    unordered_map<string, size_t> textureIndex; // path -> position in textures_loaded
+    atomic<bool> imported{false};   // set by the importing thread once pending and the bounds are filled in
+    bool ready = false;             // meshes are uploaded (GL thread only)
+    unique_ptr<Mesh> proxy;         // bounding box drawn while loading
+    MeshOptimizeStats optimizeStats;    // of the last ASSIMP import
+    unsigned long long lodTriangles[MESH_LOD_COUNT] = {};   // triangles of the whole model per level, of the last ASSIMP import
+    size_t clusterCount = 0;                                // of the last ASSIMP import
+
+    // calls f(mesh, lod, planes, viewer) for every mesh inside the frustum, with planes (object space) set when the
+    // mesh is drawn at full detail with cluster culling and nullptr otherwise
+    template <typename F>
+    void forEachVisibleMesh(const glm::mat4 &modelMatrix, const RenderView &view, F f)
+    {
+        // culling happens in object space, so the bounds of the meshes and clusters are used as they are
+        glm::vec4 planes[6];
+        ExtractFrustumPlanes(view.projection * view.view * modelMatrix, planes);
+        glm::vec3 viewer = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(view.position, 1.0f));
+        // the largest axis scale, so the error on screen is never underestimated
+        float scale = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+            scale = std::max(scale, glm::length(glm::vec3(modelMatrix[axis])));
+        // pixels covered by one world unit at distance one
+        float pixelsPerUnit = view.viewportHeight / (2.0f * std::tan(view.fovY * 0.5f));
+        for (Mesh &mesh : meshes)
+        {
+            if (!SphereInFrustum(planes, mesh.boundsCenter, mesh.boundsRadius))
+            {
+                RenderStats::Frame().meshesCulled++;
+                continue;
+            }
+            unsigned int lod = 0;
+            if (view.meshLod)
+            {
+                // distance to the closest point of the bounding sphere, clamped to the near plane
+                float distance = std::max((glm::length(mesh.boundsCenter - viewer) - mesh.boundsRadius) * scale, 0.1f);
+                for (unsigned int level = mesh.LodCount() - 1; level > 0; level--)
+                {
+                    if (mesh.lods[level].error * scale * pixelsPerUnit / distance <= lodPixelError)
+                    {
+                        lod = level;
+                        break;
+                    }
+                }
+            }
+            f(mesh, lod, lod == 0 && view.clusterCulling ? planes : nullptr, viewer);
+        }
+    }
+
+    void computeBounds()
+    {
+        bool first = true;
+        for (const MeshData &data : pending)
+        {
+            const Vertex *vertices = data.VertexData();
+            for (unsigned int i = 0; i < data.VertexCount(); i++)
+            {
+                if (first)
+                {
+                    boundsMin = boundsMax = vertices[i].Position;
+                    first = false;
+                }
+                boundsMin = glm::min(boundsMin, vertices[i].Position);
+                boundsMax = glm::max(boundsMax, vertices[i].Position);
+            }
+        }
+    }
+
+    // the box drawn while loading, built on first use
+    Mesh &proxyMesh()
+    {
+        if (!proxy)
+        {
+            // 6 faces with their own normals, 4 corners each
+            static const float corners[6][4][3] = {
+                {{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}}, {{0, 0, 1}, {0, 1, 1}, {0, 1, 0}, {0, 0, 0}},
+                {{0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}}, {{0, 0, 1}, {0, 0, 0}, {1, 0, 0}, {1, 0, 1}},
+                {{1, 0, 1}, {1, 1, 1}, {0, 1, 1}, {0, 0, 1}}, {{0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}}
+            };
+            static const glm::vec3 normals[6] = {
+                glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+            };
+            vector<Vertex> vertices;
+            vector<unsigned int> indices;
+            for (unsigned int face = 0; face < 6; face++)
+            {
+                for (unsigned int corner = 0; corner < 4; corner++)
+                {
+                    Vertex vertex = Vertex();
+                    glm::vec3 t(corners[face][corner][0], corners[face][corner][1], corners[face][corner][2]);
+                    vertex.Position = boundsMin + (boundsMax - boundsMin) * t;
+                    vertex.Normal = normals[face];
+                    vertex.TexCoords = glm::vec2(corner == 1 || corner == 2 ? 1.0f : 0.0f, corner >= 2 ? 1.0f : 0.0f);
+                    vertices.push_back(vertex);
+                }
+                unsigned int base = face * 4;
+                unsigned int quad[6] = {base, base + 1, base + 2, base, base + 2, base + 3};
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+            unsigned int white = TextureLoader::Instance().FallbackTexture();
+            vector<Texture> textures = {{white, "texture_diffuse", ""}, {white, "texture_specular", ""}};
+            proxy.reset(new Mesh(std::move(vertices), std::move(indices), std::move(textures)));
+            proxy->glslIdentifierPrefix = glslIdentifierPrefix;
+        }
+        return *proxy;
+    }
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the pending vector.
+    // a warm start maps the binary mesh cache written by a previous run instead and skips ASSIMP entirely.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        auto start = chrono::steady_clock::now();
+        this->path = path;
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        TraceScope cacheTrace("model", "mesh cache");
+        if (useMeshCache && cache.Open(path, MODEL_IMPORT_FLAGS))
+        {
+            pending = std::move(cache.meshes);
+            long long warm = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+            cout << "MODEL::LOAD:: " << path << " warm (mesh cache): " << warm / 1000.0 << " ms";
+            if (cache.coldLoadMicros > 0 && warm > 0)
+                cout << ", cold was " << cache.coldLoadMicros / 1000.0 << " ms (" << (double)cache.coldLoadMicros / warm << "x)";
+            cout << endl;
+            return;
+        }
+
+        cacheTrace.End();
+        optimizeStats = MeshOptimizeStats();
+        std::fill(lodTriangles, lodTriangles + MESH_LOD_COUNT, 0);
+        clusterCount = 0;
+        ObjScene objScene;
+        bool native = false;
+        if (useObjLoader && IsObjFile(path))
+        {
+            {
+                TraceScope parseTrace("model", "obj parse");
+                native = LoadObj(path, objScene);
+            }
+            if (native)
+                processObj(objScene);
+            else
+                cout << "WARNING::OBJ:: " << path << ": " << objScene.error << ", falling back to ASSIMP" << endl;
+        }
+        if (!native && !loadAssimp(path))
+            return;
+
+        long long cold = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        cout << "MODEL::LOAD:: " << path << " cold (";
+        if (native)
+            cout << "obj, " << objScene.threads << " threads, parse " << objScene.parseMicros / 1000.0 << " ms, build "
+                 << objScene.buildMicros / 1000.0 << " ms";
+        else
+            cout << "assimp";
+        cout << "): " << cold / 1000.0 << " ms" << endl;
+        cout << "MODEL::OPTIMIZE:: " << path << ": " << optimizeStats.imported.triangles << " triangles, vertices "
+             << optimizeStats.imported.vertices << " -> " << optimizeStats.optimized.vertices << ", ACMR " << optimizeStats.imported.ACMR()
+             << " -> " << optimizeStats.welded.ACMR() << " (welded) -> " << optimizeStats.optimized.ACMR() << ", ATVR "
+             << optimizeStats.imported.ATVR() << " -> " << optimizeStats.welded.ATVR() << " (welded) -> " << optimizeStats.optimized.ATVR()
+             << " (FIFO " << VERTEX_CACHE_SIZE << ")" << endl;
+        cout << "MODEL::LOD:: " << path << ": triangles per level";
+        for (unsigned int level = 0; level < MESH_LOD_COUNT; level++)
+            cout << (level ? " / " : " ") << lodTriangles[level];
+        cout << ", " << clusterCount << " clusters" << endl;
+        TraceScope writeTrace("model", "write mesh cache");
+        if (useMeshCache && !MeshCache::Write(path, MODEL_IMPORT_FLAGS, pending, (uint64_t)cold))
+            cout << "WARNING::MODEL:: could not write mesh cache " << MeshCache::CachePathFor(path) << endl;
+    }
+
+    // reads the file via ASSIMP into pending, returns false if ASSIMP could not read it
+    bool loadAssimp(string const &path)
+    {
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // the importer takes ownership of the IO handler
+        importer.SetIOHandler(new AssetIOSystem());
+        const aiScene* scene;
+        {
+            TraceScope importTrace("model", "assimp import");
+            scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+        }
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
+        pending.reserve(scene->mNumMeshes);
+        TraceScope processTrace("model", "processMesh");
         processNode(scene->mRootNode, scene);
+        return true;
+    }
+
+    // moves the meshes of the native OBJ reader into pending, with the textures ASSIMP would report for their materials
+    void processObj(ObjScene &scene)
+    {
+        TraceScope trace("model", "processObj");
+        pending.reserve(scene.meshes.size());
+        for (ObjMesh &mesh : scene.meshes)
+        {
+            MeshData data;
+            data.vertices = std::move(mesh.vertices);
+            data.indices = std::move(mesh.indices);
+            if (mesh.material >= 0)
+            {
+                const ObjMaterial &material = scene.materials[mesh.material];
+                // same order and types as loadMaterialTextures() in processMesh()
+                const pair<const string *, const char *> maps[] = {
+                    {&material.diffuse, "texture_diffuse"}, {&material.specular, "texture_specular"},
+                    {&material.bump, "texture_normal"}, {&material.ambient, "texture_height"}
+                };
+                for (const auto &map : maps)
+                    if (!map.first->empty())
+                        data.textures.push_back({map.second, *map.first});
+            }
+            optimizeTriangles(data);
+            pending.push_back(std::move(data));
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -81,7 +524,7 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            pending.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
@@ -91,17 +534,21 @@ private:
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        // data to fill. The vertex and index storage is allocated once at its final size and filled in place;
+        // it is then moved (never copied) through pending into the Mesh.
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<TextureRef> &textures = data.textures;
+        vertices.resize(mesh->mNumVertices);   // value-initialized, meshes without texture coordinates get zero tangents
+        indices.reserve((size_t)mesh->mNumFaces * 3);  // exact after aiProcess_Triangulate
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex &vertex = vertices[i];
             glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -138,18 +585,24 @@ private:
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
-
-
         }
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        bool onlyTriangles = true;
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
+            onlyTriangles = onlyTriangles && face.mNumIndices == 3;
+        }
+        // line and point primitives are left as they are
+        if (onlyTriangles)
+            optimizeTriangles(data);
+        else
+        {
+            for (unsigned int level = 0; level < MESH_LOD_COUNT; level++)
+                lodTriangles[level] += indices.size() / 3;
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
@@ -164,96 +617,95 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
 
+        // return the extracted mesh data, the GL objects are created later in Upload()
+        return data;
+    }
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+    // welds the duplicated vertices, reorders for the vertex caches and builds the levels of detail and clusters of a triangle mesh
+    void optimizeTriangles(MeshData &data)
+    {
+        optimizeStats.Add(OptimizeMesh(data.vertices, data.indices));
+        data.lods = GenerateLods(data.vertices, data.indices);
+        data.clusters = BuildClusters(data.vertices, data.indices, 0, data.lods[0].indexCount);
+        clusterCount += data.clusters.size();
+        for (unsigned int level = 0; level < MESH_LOD_COUNT; level++)
+            lodTriangles[level] += data.lods[std::min<size_t>(level, data.lods.size() - 1)].indexCount / 3;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects all material textures of a given type. Only the references are recorded here,
+    // the textures themselves are loaded (once per path) in Upload().
+    void loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            TextureRef texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+    }
+
+    // hashes the texture files the meshes reference (once per path), so Upload() only looks them up in the registry
+    // instead of reading every file on the GL thread
+    void hashTextures()
+    {
+        unordered_map<string, pair<uint64_t, size_t>> hashed;
+        for (MeshData &data : pending)
+        {
+            for (TextureRef &ref : data.textures)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                auto it = hashed.find(ref.path);
+                if (it == hashed.end())
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    size_t fileBytes;
+                    uint64_t content = TextureRegistry::HashFile(directory + '/' + ref.path, fileBytes);
+                    it = hashed.emplace(ref.path, make_pair(content, fileBytes)).first;
                 }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+                ref.content = it->second.first;
+                ref.fileBytes = it->second.second;
             }
         }
-        return textures;
+    }
+
+    // returns the texture at the given path (relative to the model directory), acquiring it only the first time this model references it.
+    // textures shared with other models are deduplicated by the TextureRegistry.
+    Texture loadTexture(const TextureRef &ref)
+    {
+        const string &path = ref.path;
+        // check if texture was loaded before and if so, reuse it: skip loading a new texture
+        auto loaded = textureIndex.find(path);
+        if (loaded != textureIndex.end())
+            return textures_loaded[loaded->second]; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), this->directory, false, ref.content, ref.fileBytes);
+        texture.type = ref.type;
+        texture.path = path;
+        textureIndex[path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
     }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// returns the texture id right away; the image is decoded on a worker thread and uploaded by TextureLoader::ProcessUploads()/Finish().
+// the id is shared through the TextureRegistry, so the same image is only loaded once per process.
+// content and fileBytes are TextureRegistry::HashFile() of the file when the caller already hashed it.
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, uint64_t content, size_t fileBytes)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureRegistry::Instance().Acquire2D(filename, content, fileBytes);
 }
 #endif
@@ -0,0 +1,106 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+// imports several models concurrently on a thread pool. The GL thread drains the finished imports
+// and uploads each model as soon as it is ready, so startup is bounded by the slowest asset instead of the sum of all of them.
+// either block on Finish() or keep rendering and call Poll() once per frame; models draw as proxies until then.
+class ModelLoader
+{
+public:
+    explicit ModelLoader(unsigned int threadCount = 0) : pool(threadCount)
+    {
+    }
+
+    // queues the CPU phase of loading path into model. model must outlive the loader (or the next Finish()).
+    void Load(Model &model, const std::string &path)
+    {
+        if (queued == uploaded)
+            start = std::chrono::steady_clock::now();
+        queued++;
+        pool.Submit([this, &model, path] {
+            auto importStart = std::chrono::steady_clock::now();
+            try
+            {
+                model.Import(path);
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "ERROR::MODEL_LOADER:: importing " << path << " failed: " << e.what() << std::endl;
+            }
+            importMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - importStart).count();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                imported.push_back(&model);
+            }
+            importDone.notify_one();
+        });
+    }
+
+    // uploads the models whose import already finished, without waiting. Returns how many were uploaded.
+    unsigned int Poll()
+    {
+        unsigned int count = 0;
+        while (Model *model = next(false))
+        {
+            upload(model);
+            count++;
+        }
+        return count;
+    }
+
+    // blocks until every queued model has been imported and uploaded. Must be called on the GL thread.
+    void Finish()
+    {
+        while (uploaded < queued)
+            upload(next(true));
+    }
+
+    bool Done() const { return uploaded == queued; }
+
+private:
+    std::mutex mutex;
+    std::condition_variable importDone;
+    std::deque<Model *> imported;
+    std::atomic<long long> importMicros{0};
+    unsigned int queued = 0;
+    unsigned int uploaded = 0;
+    std::chrono::steady_clock::time_point start;
+    // declared last so the workers are joined before the state they use is destroyed
+    ThreadPool pool;
+
+    Model *next(bool wait)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait)
+            importDone.wait(lock, [this] { return !imported.empty(); });
+        if (imported.empty())
+            return nullptr;
+        Model *model = imported.front();
+        imported.pop_front();
+        return model;
+    }
+
+    void upload(Model *model)
+    {
+        model->Upload();
+        uploaded++;
+        if (uploaded == queued)
+            std::cout << "MODEL::LOADER:: " << queued << " models on " << pool.ThreadCount() << " threads: "
+                      << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0
+                      << " ms wall, " << importMicros / 1000.0 << " ms summed import time" << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,671 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// native Wavefront OBJ/MTL reader for the assets this project ships, GL-free so it runs on the import workers.
+// the file is memory-mapped (or served from the asset pack) and split at line boundaries into chunks that are parsed concurrently; the chunks are then
+// stitched together and every mesh is built in parallel, directly as the indexed Vertex arrays Mesh uploads.
+//
+// the result matches what ASSIMP produces with MODEL_IMPORT_FLAGS: polygons are triangulated as fans, missing normals
+// are smoothed per position, tangents use ASSIMP's CalcTangentSpace formula and the v coordinate is flipped. Like ASSIMP's
+// OBJ importer, a new mesh starts at every 'o' and at every 'usemtl' that changes the material.
+// files with line or point elements are rejected, Model falls back to ASSIMP for those and for anything malformed.
+
+namespace obj {
+
+// no chunk is smaller than this, small files are parsed on the calling thread only
+const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+struct Corner {
+    int32_t position;
+    int32_t texCoord;   // -1 when the face has no texture coordinates
+    int32_t normal;     // -1 when the face has no normals
+};
+
+// a negative (relative) index resolved against the elements of its own chunk, fixed up once the chunk offsets are known
+struct RelativeIndex {
+    uint32_t corner;
+    uint32_t component; // 0 position, 1 texCoord, 2 normal
+    int32_t  local;     // may be negative when it points into a previous chunk
+};
+
+// an 'o', 'usemtl' or 'mtllib' line, in the order of the triangles around it
+struct Event {
+    enum Kind { Object, Material, Library };
+    Kind     kind;
+    uint32_t triangle;  // chunk-local index of the first triangle after the line
+    std::string name;
+};
+
+struct Chunk {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<Corner> corners;    // three per triangle
+    std::vector<RelativeIndex> relative;
+    std::vector<Event> events;
+    bool ok = true;
+    std::string error;
+};
+
+// runs work(i) for every i < count on threadCount threads, the calling thread included
+template<typename F>
+void ParallelFor(size_t count, unsigned int threadCount, F work)
+{
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+            work(i);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < std::min<size_t>(threadCount, count); t++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+inline bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline void SkipBlanks(const char *&p, const char *end)
+{
+    while (p < end && IsBlank(*p))
+        p++;
+}
+
+inline const char *LineEnd(const char *p, const char *end)
+{
+    const void *newline = std::memchr(p, '\n', (size_t)(end - p));
+    return newline ? static_cast<const char *>(newline) : end;
+}
+
+// decimal float without locale or allocation. Up to 19 significant digits are kept, which is well beyond float precision.
+inline bool ParseFloat(const char *&p, const char *end, float &value)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    SkipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    const char *start = p;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+            exponent++;
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (p == start || (p == start + 1 && *start == '.'))
+        return false;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+        int e = 0;
+        if (p >= end || *p < '0' || *p > '9')
+            return false;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            e = std::min(e * 10 + (*p - '0'), 10000);
+        exponent += negativeExponent ? -e : e;
+    }
+    double result = (double)mantissa;
+    if (exponent < 0)
+        result = -exponent <= 22 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        result = exponent <= 22 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+    value = (float)(negative ? -result : result);
+    return true;
+}
+
+inline bool ParseInt(const char *&p, const char *end, int32_t &value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    const char *start = p;
+    int64_t result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+    value = (int32_t)(negative ? -result : result);
+    return p != start;
+}
+
+// the rest of the line without surrounding blanks
+inline std::string RestOfLine(const char *p, const char *end)
+{
+    SkipBlanks(p, end);
+    while (end > p && IsBlank(end[-1]))
+        end--;
+    return std::string(p, end);
+}
+
+// parses the lines in [begin, end), which start and stop at line boundaries
+inline void ParseChunk(const char *begin, const char *end, Chunk &chunk)
+{
+    std::vector<Corner> polygon;
+    std::vector<int32_t> polygonRelative[3];    // local indices of relative references, per corner of the polygon
+    const char *p = begin;
+    while (p < end && chunk.ok)
+    {
+        const char *lineEnd = LineEnd(p, end);
+        SkipBlanks(p, lineEnd);
+        if (p + 1 < lineEnd)
+        {
+            char c0 = p[0], c1 = p[1];
+            if (c0 == 'v' && IsBlank(c1))
+            {
+                p++;
+                glm::vec3 position;
+                if (!ParseFloat(p, lineEnd, position.x) || !ParseFloat(p, lineEnd, position.y) || !ParseFloat(p, lineEnd, position.z))
+                    chunk.ok = false;
+                chunk.positions.push_back(position);
+            }
+            else if (c0 == 'v' && c1 == 't' && p + 2 < lineEnd && IsBlank(p[2]))
+            {
+                p += 2;
+                glm::vec2 texCoord(0.0f);
+                if (!ParseFloat(p, lineEnd, texCoord.x))
+                    chunk.ok = false;
+                // the v coordinate is optional in the format
+                const char *next = p;
+                SkipBlanks(next, lineEnd);
+                if (next < lineEnd && !ParseFloat(p, lineEnd, texCoord.y))
+                    chunk.ok = false;
+                chunk.texCoords.push_back(texCoord);
+            }
+            else if (c0 == 'v' && c1 == 'n' && p + 2 < lineEnd && IsBlank(p[2]))
+            {
+                p += 2;
+                glm::vec3 normal;
+                if (!ParseFloat(p, lineEnd, normal.x) || !ParseFloat(p, lineEnd, normal.y) || !ParseFloat(p, lineEnd, normal.z))
+                    chunk.ok = false;
+                chunk.normals.push_back(normal);
+            }
+            else if (c0 == 'f' && IsBlank(c1))
+            {
+                p++;
+                polygon.clear();
+                for (auto &relative : polygonRelative)
+                    relative.clear();
+                int32_t counts[3] = {(int32_t)chunk.positions.size(), (int32_t)chunk.texCoords.size(), (int32_t)chunk.normals.size()};
+                for (SkipBlanks(p, lineEnd); p < lineEnd && chunk.ok; SkipBlanks(p, lineEnd))
+                {
+                    // v, v/vt, v//vn or v/vt/vn
+                    int32_t values[3] = {0, 0, 0};
+                    for (int component = 0; component < 3 && chunk.ok; component++)
+                    {
+                        if (component > 0)
+                        {
+                            if (p >= lineEnd || *p != '/')
+                                break;
+                            p++;
+                            if (component == 1 && p < lineEnd && *p == '/')
+                                continue;
+                        }
+                        if (!ParseInt(p, lineEnd, values[component]) || values[component] == 0)
+                            chunk.ok = false;
+                    }
+                    Corner corner;
+                    int32_t *fields[3] = {&corner.position, &corner.texCoord, &corner.normal};
+                    for (int component = 0; component < 3; component++)
+                    {
+                        if (values[component] > 0)
+                            *fields[component] = values[component] - 1;
+                        else if (values[component] < 0)
+                        {
+                            // resolved after the chunk offsets are known, the position in the polygon is kept meanwhile
+                            *fields[component] = -1;
+                            polygonRelative[component].push_back((int32_t)polygon.size());
+                            polygonRelative[component].push_back(counts[component] + values[component]);
+                        }
+                        else
+                            *fields[component] = -1;
+                    }
+                    if (values[0] == 0)
+                        chunk.ok = false;
+                    polygon.push_back(corner);
+                }
+                if (polygon.size() < 3)
+                    chunk.ok = false;
+                if (!chunk.ok)
+                {
+                    chunk.error = "malformed face";
+                    break;
+                }
+                // fan triangulation, the output corner of every polygon corner is recorded for the relative references
+                uint32_t first = (uint32_t)chunk.corners.size();
+                for (size_t k = 1; k + 1 < polygon.size(); k++)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[k]);
+                    chunk.corners.push_back(polygon[k + 1]);
+                }
+                for (uint32_t component = 0; component < 3; component++)
+                {
+                    for (size_t r = 0; r < polygonRelative[component].size(); r += 2)
+                    {
+                        size_t k = (size_t)polygonRelative[component][r];
+                        int32_t local = polygonRelative[component][r + 1];
+                        // every triangle that uses polygon corner k
+                        for (size_t t = 0; t + 2 < polygon.size(); t++)
+                        {
+                            uint32_t base = first + (uint32_t)t * 3;
+                            if (k == 0)
+                                chunk.relative.push_back({base, component, local});
+                            if (k == t + 1)
+                                chunk.relative.push_back({base + 1, component, local});
+                            if (k == t + 2)
+                                chunk.relative.push_back({base + 2, component, local});
+                        }
+                    }
+                }
+            }
+            else if ((c0 == 'l' || c0 == 'p') && IsBlank(c1))
+            {
+                chunk.ok = false;
+                chunk.error = "line and point elements are not supported";
+            }
+            else if (c0 == 'o' && IsBlank(c1))
+                chunk.events.push_back({Event::Object, (uint32_t)(chunk.corners.size() / 3), RestOfLine(p + 1, lineEnd)});
+            else if (lineEnd - p > 7 && std::memcmp(p, "usemtl", 6) == 0 && IsBlank(p[6]))
+                chunk.events.push_back({Event::Material, (uint32_t)(chunk.corners.size() / 3), RestOfLine(p + 6, lineEnd)});
+            else if (lineEnd - p > 7 && std::memcmp(p, "mtllib", 6) == 0 && IsBlank(p[6]))
+                chunk.events.push_back({Event::Library, (uint32_t)(chunk.corners.size() / 3), RestOfLine(p + 6, lineEnd)});
+            // comments, groups, smoothing groups and everything else are ignored
+            if (!chunk.ok && chunk.error.empty())
+                chunk.error = "malformed vertex data";
+        }
+        p = lineEnd + 1;
+    }
+}
+
+} // namespace obj
+
+// texture maps of an MTL material, paths relative to the model directory, empty when the map is not set
+struct ObjMaterial {
+    std::string name;
+    std::string diffuse;    // map_Kd
+    std::string specular;   // map_Ks
+    std::string bump;       // map_Bump / bump, ASSIMP reports these as height maps
+    std::string ambient;    // map_Ka
+};
+
+struct ObjMesh {
+    std::vector<Vertex>       vertices;
+    std::vector<unsigned int> indices;
+    int material = -1;      // into ObjScene::materials, -1 without a known material
+};
+
+struct ObjScene {
+    std::vector<ObjMesh> meshes;
+    std::vector<ObjMaterial> materials;
+    unsigned int threads = 1;       // used for parsing
+    unsigned int chunks = 0;
+    long long parseMicros = 0;      // mapping and parsing the OBJ text
+    long long buildMicros = 0;      // stitching the chunks and building the indexed meshes
+    std::string error;
+};
+
+// reads the materials of an MTL file and appends them to materials. Texture options (-bm, -o, ...) are skipped,
+// the file name is the last token of the line.
+inline bool LoadMtl(const std::string &path, std::vector<ObjMaterial> &materials)
+{
+    AssetData file;
+    if (!file.Open(path))
+        return false;
+    const char *p = reinterpret_cast<const char *>(file.Data());
+    const char *end = p + file.Size();
+    auto lastToken = [](const std::string &rest) {
+        size_t last = rest.find_last_of(" \t");
+        return last == std::string::npos ? rest : rest.substr(last + 1);
+    };
+    while (p < end)
+    {
+        const char *lineEnd = obj::LineEnd(p, end);
+        obj::SkipBlanks(p, lineEnd);
+        const char *keyEnd = p;
+        while (keyEnd < lineEnd && !obj::IsBlank(*keyEnd))
+            keyEnd++;
+        std::string key(p, keyEnd);
+        std::string rest = obj::RestOfLine(keyEnd, lineEnd);
+        if (key == "newmtl")
+        {
+            materials.push_back(ObjMaterial());
+            materials.back().name = rest;
+        }
+        else if (!materials.empty() && !rest.empty())
+        {
+            if (key == "map_Kd")
+                materials.back().diffuse = lastToken(rest);
+            else if (key == "map_Ks")
+                materials.back().specular = lastToken(rest);
+            else if (key == "map_Bump" || key == "map_bump" || key == "bump")
+                materials.back().bump = lastToken(rest);
+            else if (key == "map_Ka")
+                materials.back().ambient = lastToken(rest);
+        }
+        p = lineEnd + 1;
+    }
+    return true;
+}
+
+namespace obj {
+
+// one output mesh: the triangle ranges of the chunks it covers
+struct Group {
+    int material = -1;
+    struct Range { uint32_t chunk, begin, end; };
+    std::vector<Range> ranges;
+    size_t triangles = 0;
+};
+
+// deduplicates the (position, texCoord, normal) corners of a group into vertices and computes what the file lacks
+inline void BuildMesh(const Group &group, const std::vector<Chunk> &chunks, const std::vector<glm::vec3> &positions,
+                      const std::vector<glm::vec2> &texCoords, const std::vector<glm::vec3> &normals, ObjMesh &mesh)
+{
+    mesh.material = group.material;
+    size_t cornerCount = group.triangles * 3;
+    size_t tableSize = 1;
+    while (tableSize < cornerCount * 2)
+        tableSize <<= 1;
+    const unsigned int empty = ~0u;
+    std::vector<unsigned int> table(tableSize, empty);
+    std::vector<Corner> keys;           // corner each vertex was created from
+    keys.reserve(cornerCount / 2);
+    mesh.indices.reserve(cornerCount);
+    for (const Group::Range &range : group.ranges)
+    {
+        const Corner *corners = chunks[range.chunk].corners.data();
+        for (size_t c = (size_t)range.begin * 3; c < (size_t)range.end * 3; c++)
+        {
+            const Corner &corner = corners[c];
+            size_t slot = HashBytes(&corner, sizeof(Corner)) & (tableSize - 1);
+            while (table[slot] != empty && std::memcmp(&keys[table[slot]], &corner, sizeof(Corner)) != 0)
+                slot = (slot + 1) & (tableSize - 1);
+            if (table[slot] == empty)
+            {
+                table[slot] = (unsigned int)keys.size();
+                keys.push_back(corner);
+            }
+            mesh.indices.push_back(table[slot]);
+        }
+    }
+
+    std::vector<Vertex> &vertices = mesh.vertices;
+    vertices.resize(keys.size());   // value-initialized: zero uv and tangents where the file has none
+    bool hasTexCoords = false;
+    bool missingNormals = false;
+    for (size_t v = 0; v < keys.size(); v++)
+    {
+        vertices[v].Position = positions[keys[v].position];
+        if (keys[v].normal >= 0)
+            vertices[v].Normal = normals[keys[v].normal];
+        else
+            missingNormals = true;
+        if (keys[v].texCoord >= 0)
+        {
+            vertices[v].TexCoords = texCoords[keys[v].texCoord];
+            hasTexCoords = true;
+        }
+    }
+
+    // aiProcess_GenSmoothNormals: average of the unit face normals around each position
+    if (missingNormals)
+    {
+        std::unordered_map<int32_t, glm::vec3> smooth;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            const glm::vec3 &p0 = vertices[mesh.indices[i]].Position;
+            glm::vec3 normal = glm::cross(vertices[mesh.indices[i + 1]].Position - p0, vertices[mesh.indices[i + 2]].Position - p0);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+            for (unsigned int k = 0; k < 3; k++)
+                if (keys[mesh.indices[i + k]].normal < 0)
+                    smooth.emplace(keys[mesh.indices[i + k]].position, glm::vec3(0.0f)).first->second += normal * (1.0f / length);
+        }
+        for (size_t v = 0; v < keys.size(); v++)
+        {
+            if (keys[v].normal >= 0)
+                continue;
+            auto found = smooth.find(keys[v].position);
+            float length = found != smooth.end() ? glm::length(found->second) : 0.0f;
+            vertices[v].Normal = length > 0.0f ? found->second * (1.0f / length) : glm::vec3(0.0f);
+        }
+    }
+
+    // aiProcess_CalcTangentSpace: per-face tangents orthogonalized against the vertex normal, averaged over the faces
+    // sharing the vertex. ASSIMP computes them before flipping the v coordinate, so the same happens here.
+    if (hasTexCoords)
+    {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            const Vertex &v0 = vertices[mesh.indices[i]];
+            const Vertex &v1 = vertices[mesh.indices[i + 1]];
+            const Vertex &v2 = vertices[mesh.indices[i + 2]];
+            glm::vec3 e1 = v1.Position - v0.Position, e2 = v2.Position - v0.Position;
+            float sx = v1.TexCoords.x - v0.TexCoords.x, sy = v1.TexCoords.y - v0.TexCoords.y;
+            float tx = v2.TexCoords.x - v0.TexCoords.x, ty = v2.TexCoords.y - v0.TexCoords.y;
+            float direction = (tx * sy - ty * sx) < 0.0f ? -1.0f : 1.0f;
+            // all three corners at the same uv: use the default uv directions
+            if (sx * ty == sy * tx)
+            {
+                sx = 0.0f; sy = 1.0f;
+                tx = 1.0f; ty = 0.0f;
+            }
+            glm::vec3 tangent = (e2 * sy - e1 * ty) * direction;
+            glm::vec3 bitangent = (e2 * sx - e1 * tx) * direction;
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                Vertex &vertex = vertices[mesh.indices[i + k]];
+                glm::vec3 t = tangent - vertex.Normal * glm::dot(tangent, vertex.Normal);
+                glm::vec3 b = bitangent - vertex.Normal * glm::dot(bitangent, vertex.Normal);
+                float tLength = glm::length(t), bLength = glm::length(b);
+                if (tLength > 0.0f)
+                    vertex.Tangent += t * (1.0f / tLength);
+                if (bLength > 0.0f)
+                    vertex.Bitangent += b * (1.0f / bLength);
+            }
+        }
+        for (Vertex &vertex : vertices)
+        {
+            float tLength = glm::length(vertex.Tangent), bLength = glm::length(vertex.Bitangent);
+            if (tLength > 0.0f)
+                vertex.Tangent = vertex.Tangent * (1.0f / tLength);
+            if (bLength > 0.0f)
+                vertex.Bitangent = vertex.Bitangent * (1.0f / bLength);
+        }
+    }
+    // aiProcess_FlipUVs
+    for (Vertex &vertex : vertices)
+        vertex.TexCoords.y = 1.0f - vertex.TexCoords.y;
+}
+
+} // namespace obj
+
+// loads an OBJ file and the MTL libraries it references. threadCount == 0 uses one thread per hardware thread.
+// returns false (with scene.error set) on anything the reader does not handle, the caller should fall back to ASSIMP then.
+inline bool LoadObj(const std::string &path, ObjScene &scene, unsigned int threadCount = 0)
+{
+    using namespace obj;
+    auto start = std::chrono::steady_clock::now();
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    AssetData file;
+    if (!file.Open(path))
+    {
+        scene.error = "could not open " + path;
+        return false;
+    }
+    const char *data = reinterpret_cast<const char *>(file.Data());
+    const char *end = data + file.Size();
+
+    // chunk boundaries just after a newline, so no line is split
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, file.Size() / MIN_CHUNK_BYTES));
+    std::vector<const char *> bounds(1, data);
+    for (size_t c = 1; c < chunkCount; c++)
+    {
+        const char *cut = std::max(bounds.back(), data + file.Size() * c / chunkCount);
+        cut = LineEnd(cut, end);
+        bounds.push_back(cut < end ? cut + 1 : end);
+    }
+    bounds.push_back(end);
+    std::vector<Chunk> chunks(chunkCount);
+    ParallelFor(chunkCount, threadCount, [&](size_t c) { ParseChunk(bounds[c], bounds[c + 1], chunks[c]); });
+    scene.threads = (unsigned int)std::min<size_t>(threadCount, chunkCount);
+    scene.chunks = (unsigned int)chunkCount;
+    auto parsed = std::chrono::steady_clock::now();
+    scene.parseMicros = std::chrono::duration_cast<std::chrono::microseconds>(parsed - start).count();
+    for (const Chunk &chunk : chunks)
+    {
+        if (!chunk.ok)
+        {
+            scene.error = chunk.error;
+            return false;
+        }
+    }
+
+    // concatenate the vertex data and turn the chunk-local references into global ones
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<int32_t> bases(chunkCount * 3);
+    for (size_t c = 0; c < chunkCount; c++)
+    {
+        bases[c * 3 + 0] = (int32_t)positions.size();
+        bases[c * 3 + 1] = (int32_t)texCoords.size();
+        bases[c * 3 + 2] = (int32_t)normals.size();
+        positions.insert(positions.end(), chunks[c].positions.begin(), chunks[c].positions.end());
+        texCoords.insert(texCoords.end(), chunks[c].texCoords.begin(), chunks[c].texCoords.end());
+        normals.insert(normals.end(), chunks[c].normals.begin(), chunks[c].normals.end());
+    }
+    int32_t limits[3] = {(int32_t)positions.size(), (int32_t)texCoords.size(), (int32_t)normals.size()};
+    for (size_t c = 0; c < chunkCount; c++)
+    {
+        Chunk &chunk = chunks[c];
+        for (const RelativeIndex &relative : chunk.relative)
+        {
+            int32_t *fields[3] = {&chunk.corners[relative.corner].position, &chunk.corners[relative.corner].texCoord,
+                                  &chunk.corners[relative.corner].normal};
+            *fields[relative.component] = bases[c * 3 + relative.component] + relative.local;
+            if (*fields[relative.component] < 0)
+            {
+                scene.error = "index out of range";
+                return false;
+            }
+        }
+        for (const Corner &corner : chunk.corners)
+        {
+            if (corner.position < 0 || corner.position >= limits[0] || corner.texCoord >= limits[1] || corner.normal >= limits[2])
+            {
+                scene.error = "index out of range";
+                return false;
+            }
+        }
+    }
+
+    // split the triangles into meshes at every object and material change
+    std::string directory = path.substr(0, path.find_last_of('/'));
+    std::unordered_map<std::string, int> materialIndex;
+    std::vector<Group> groups(1);
+    auto addRange = [&](uint32_t c, uint32_t begin, uint32_t end) {
+        if (end > begin)
+        {
+            groups.back().ranges.push_back({c, begin, end});
+            groups.back().triangles += end - begin;
+        }
+    };
+    for (uint32_t c = 0; c < chunkCount; c++)
+    {
+        uint32_t cursor = 0;
+        for (const Event &event : chunks[c].events)
+        {
+            addRange(c, cursor, event.triangle);
+            cursor = event.triangle;
+            if (event.kind == Event::Library)
+            {
+                for (size_t begin = 0; begin < event.name.size();)
+                {
+                    size_t space = event.name.find_first_of(" \t", begin);
+                    std::string library = event.name.substr(begin, space == std::string::npos ? std::string::npos : space - begin);
+                    size_t first = scene.materials.size();
+                    if (!library.empty() && LoadMtl(directory + '/' + library, scene.materials))
+                        for (size_t m = first; m < scene.materials.size(); m++)
+                            materialIndex.emplace(scene.materials[m].name, (int)m);
+                    begin = space == std::string::npos ? event.name.size() : space + 1;
+                }
+                continue;
+            }
+            int material = groups.back().material;
+            if (event.kind == Event::Material)
+            {
+                auto found = materialIndex.find(event.name);
+                material = found != materialIndex.end() ? found->second : -1;
+                if (material == groups.back().material)
+                    continue;
+            }
+            if (groups.back().triangles > 0)
+                groups.push_back(Group());
+            groups.back().material = material;
+        }
+        addRange(c, cursor, (uint32_t)(chunks[c].corners.size() / 3));
+    }
+    if (groups.back().triangles == 0)
+        groups.pop_back();
+
+    scene.meshes.resize(groups.size());
+    ParallelFor(groups.size(), threadCount, [&](size_t g) {
+        BuildMesh(groups[g], chunks, positions, texCoords, normals, scene.meshes[g]);
+    });
+    scene.buildMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - parsed).count();
+    return true;
+}
+
+inline bool IsObjFile(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return extension == "obj";
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// on-disk cache of linked shader programs (ARB_get_program_binary), so warm starts skip GLSL compilation and linking.
+// one file per program in PROGRAM_CACHE_DIRECTORY, named after the shader paths. The file stores the key it was built
+// with: a hash of the sources, the defines and the driver's vendor, renderer and version strings. A different key,
+// a binary format the driver no longer accepts or a failed link all fall back to compiling from source, which then
+// overwrites the file.
+
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+const char *const PROGRAM_CACHE_DIRECTORY = "shader_cache";
+
+struct ProgramCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint64_t binarySize;
+};
+
+class ProgramCache
+{
+public:
+    // whether the driver can hand out program binaries at all; some report the extension without any format
+    static bool Supported()
+    {
+        static int supported = -1;
+        if (supported < 0)
+        {
+            const GLExtensionFunctions &gl = GLExtensions();
+            GLint formats = 0;
+            if (gl.GetProgramBinary && gl.ProgramBinary && gl.ProgramParameteri)
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            supported = formats > 0 ? 1 : 0;
+        }
+        return supported == 1;
+    }
+
+    // identifies the program a binary was built from. Needs the GL context, the driver strings are part of it.
+    static uint64_t Key(std::initializer_list<const std::string *> sources, const std::string &defines)
+    {
+        uint64_t hash = HashBytes(&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+        for (const std::string *source : sources)
+        {
+            uint64_t size = source->size();
+            hash = HashBytes(&size, sizeof(size), hash);
+            hash = HashBytes(source->data(), source->size(), hash);
+        }
+        hash = HashBytes(defines.data(), defines.size(), hash);
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            const char *value = reinterpret_cast<const char *>(glGetString(name));
+            if (value)
+                hash = HashBytes(value, std::strlen(value) + 1, hash);
+        }
+        return hash;
+    }
+
+    // inserts the defines right after the #version line, which has to stay first in the source
+    static std::string WithDefines(const std::string &source, const std::string &defines)
+    {
+        if (defines.empty())
+            return source;
+        std::string block = defines;
+        if (block.back() != '\n')
+            block += '\n';
+        size_t version = source.find("#version");
+        if (version == std::string::npos)
+            return block + source;
+        size_t at = source.find('\n', version);
+        if (at == std::string::npos)
+            return source + '\n' + block;
+        at += 1;
+        return source.substr(0, at) + block + source.substr(at);
+    }
+
+    static std::string PathFor(const std::string &name)
+    {
+        char file[32];
+        std::snprintf(file, sizeof(file), "%016llx.glprog", (unsigned long long)HashBytes(name.data(), name.size()));
+        return std::string(PROGRAM_CACHE_DIRECTORY) + '/' + file;
+    }
+
+    // creates a linked program from the cached binary, 0 when there is none for this key or the driver rejects it
+    static GLuint Load(const std::string &name, uint64_t key)
+    {
+        if (!Supported())
+            return 0;
+        MappedFile file;
+        if (!file.Open(PathFor(name)) || file.Size() < sizeof(ProgramCacheHeader))
+            return 0;
+        ProgramCacheHeader header;
+        std::memcpy(&header, file.Data(), sizeof(header));
+        if (std::memcmp(header.magic, "LOGLPRG", 8) != 0 || header.version != PROGRAM_CACHE_VERSION || header.key != key ||
+            header.binarySize != file.Size() - sizeof(header))
+            return 0;
+        GLuint program = glCreateProgram();
+        GLExtensions().ProgramBinary(program, header.binaryFormat, file.Data() + sizeof(header), (GLsizei)header.binarySize);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            // typically a driver update that kept the version string; the caller compiles and replaces the file
+            std::cout << "SHADER::CACHE:: driver rejected the program binary of " << name << ", compiling from source" << std::endl;
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    // call before glLinkProgram, so the driver keeps the binary around for Store()
+    static void PrepareLink(GLuint program)
+    {
+        if (Supported())
+            GLExtensions().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // writes the binary of a successfully linked program
+    static bool Store(GLuint program, const std::string &name, uint64_t key)
+    {
+        if (!Supported())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<unsigned char> out(sizeof(ProgramCacheHeader) + (size_t)length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        GLExtensions().GetProgramBinary(program, length, &written, &format, out.data() + sizeof(ProgramCacheHeader));
+        if (written <= 0)
+            return false;
+        out.resize(sizeof(ProgramCacheHeader) + (size_t)written);
+        ProgramCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "LOGLPRG", 8);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.binaryFormat = format;
+        header.key = key;
+        header.binarySize = (uint64_t)written;
+        std::memcpy(out.data(), &header, sizeof(header));
+
+        // write next to the final file and rename, so a crash never leaves a half written binary behind
+        mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+        std::string path = PathFor(name);
+        std::string tmpPath = path + ".tmp";
+        FILE *f = std::fopen(tmpPath.c_str(), "wb");
+        if (!f)
+            return false;
+        bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,319 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/render_view.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// the frame is built from submissions instead of code order: every draw goes into the queue with a 64-bit sort key,
+// the queue is radix sorted once per frame and executed in key order. The pass is in the top bits, so opaque draws
+// run first, then transparent ones, then the skybox (drawn last so it only shades pixels nothing else covered).
+//
+//   opaque:      pass:2 | program:8 | material:16 | VAO:16 | depth:22   state sorted, front to back within a state
+//   transparent: pass:2 | depth:22 (inverted) | program:8 | material:16 | VAO:16   back to front, state breaks ties
+//   skybox:      pass:2 | program:8 | material:16 | VAO:16
+//
+// program, material (first texture) and VAO are the low bits of their GL names, so equal states end up next to each
+// other and the GLState cache elides the binds between them. Depth is the distance of the bounds center from the
+// camera, quantized over the far plane. Meshes share the VAO of their geometry arena, so a run of mesh draws with the
+// same state, model matrix and textures goes out as one glMultiDrawElementsBaseVertex.
+enum class RenderPass : uint64_t {
+    Opaque = 0,
+    Transparent = 1,
+    Skybox = 2
+};
+
+// the per-draw uniforms the queue sets for a program, nullptr in DrawState for programs without them (skybox)
+struct DrawUniforms {
+    UniformHandle<glm::mat4> model;
+    UniformHandle<glm::mat3> normalMatrix;
+    UniformHandle<int> transparency;
+
+    void Resolve(Shader &shader)
+    {
+        model = shader.Uniform<glm::mat4>("model");
+        normalMatrix = shader.Uniform<glm::mat3>("normalMatrix");
+        transparency = shader.Uniform<int>("transparency");
+    }
+};
+
+// everything a draw needs besides its geometry; applied through GLState, so repeating it costs nothing
+struct DrawState {
+    Shader *shader = nullptr;
+    const DrawUniforms *uniforms = nullptr;
+    RenderPass pass = RenderPass::Opaque;
+    int transparency = 0;       // value of the transparency uniform
+    bool cullBackFaces = false;
+    GLenum frontFace = GL_CCW;
+    bool depthWrite = true;
+    GLenum depthFunc = GL_LESS;
+};
+
+// a texture a raw draw binds, with the sampler uniform pointed at its unit (-1 to leave the sampler alone)
+struct RawTexture {
+    unsigned int unit;
+    GLenum target;
+    GLuint id;
+    GLint samplerLocation;
+};
+
+// geometry that is not a Mesh: a VAO drawn with glDrawElements (GL_UNSIGNED_INT indices) or glDrawArrays
+struct RawDraw {
+    GLuint vao = 0;
+    GLsizei count = 0;
+    bool indexed = false;
+    RawTexture textures[2];
+    unsigned int textureCount = 0;
+};
+
+struct DrawItem {
+    DrawState state;
+    glm::mat4 model;
+    Mesh *mesh = nullptr;           // nullptr for a raw draw
+    unsigned int lod = 0;
+    bool clusters = false;          // DrawClusters() with planes and viewer in the object space of the mesh
+    glm::vec4 planes[6];
+    glm::vec3 viewer;
+    InstanceBuffer *instances = nullptr;    // DrawInstanced() with its Count() when set
+    RawDraw raw;
+};
+
+class RenderQueue
+{
+public:
+    static const unsigned int DEPTH_BITS = 22;
+
+    // starts a frame, drops the draws of the last one but keeps their storage
+    void Begin(const RenderView &view)
+    {
+        items.clear();
+        keys.clear();
+        cameraPosition = view.position;
+        farPlane = view.farPlane;
+    }
+
+    // a mesh at the given level of detail. planes and viewer are only used (and copied) for cluster culling.
+    void Submit(const DrawState &state, const glm::mat4 &model, Mesh &mesh, unsigned int lod,
+                const glm::vec4 *planes = nullptr, const glm::vec3 &viewer = glm::vec3(0.0f))
+    {
+        DrawItem &item = add(state, model);
+        item.mesh = &mesh;
+        item.lod = lod;
+        item.clusters = planes != nullptr;
+        if (planes)
+        {
+            std::copy(planes, planes + 6, item.planes);
+            item.viewer = viewer;
+        }
+        GLuint material = mesh.textures.empty() ? 0 : mesh.textures[0].id;
+        keys.push_back({makeKey(state, material, mesh.VAO, glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f))),
+                        (uint32_t)(items.size() - 1)});
+    }
+
+    // instanceCount copies of a mesh whose VAO has an InstanceBuffer attached. The instances are drawn in buffer order,
+    // center is the world space point the whole batch is sorted by.
+    void SubmitInstanced(const DrawState &state, Mesh &mesh, unsigned int lod, InstanceBuffer &instances, const glm::vec3 &center)
+    {
+        if (instances.Count() == 0)
+            return;
+        DrawItem &item = add(state, glm::mat4(1.0f));
+        item.mesh = &mesh;
+        item.lod = lod;
+        item.clusters = false;
+        item.instances = &instances;
+        GLuint material = mesh.textures.empty() ? 0 : mesh.textures[0].id;
+        keys.push_back({makeKey(state, material, mesh.VAO, center), (uint32_t)(items.size() - 1)});
+    }
+
+    // raw geometry, center is the world space point its depth is measured at
+    void SubmitRaw(const DrawState &state, const glm::mat4 &model, const RawDraw &draw, const glm::vec3 &center)
+    {
+        DrawItem &item = add(state, model);
+        item.raw = draw;
+        GLuint material = draw.textureCount ? draw.textures[0].id : 0;
+        keys.push_back({makeKey(state, material, draw.vao, center), (uint32_t)(items.size() - 1)});
+    }
+
+    // sorts the draws of the frame and issues them. Leaves depth writes on, GL_LESS and culling off, as glClear and
+    // ImGui expect.
+    void Execute()
+    {
+        sortKeys();
+        GLState &state = GLState::Instance();
+        lastUniforms = nullptr;
+        lastModel = nullptr;
+        for (size_t i = 0; i < keys.size();)
+        {
+            const DrawItem &item = items[keys[i++].index];
+            Shader &shader = *item.state.shader;
+            apply(item);
+            if (item.mesh && item.instances)
+            {
+                // the instance attributes are VAO state, and the instanced VAO is shared with every other buffer's instances
+                item.instances->Attach(item.mesh->InstancedVAO());
+                item.mesh->DrawInstanced(shader, item.instances->Count(), item.lod);
+            }
+            else if (item.mesh)
+            {
+                batch.Clear();
+                append(item, batch);
+                while (i < keys.size() && batches(item, items[keys[i].index]))
+                    append(items[keys[i++].index], batch);
+                if (!batch.Empty())
+                    item.mesh->DrawBatch(shader, batch);
+            }
+            else
+                drawRaw(item.raw);
+        }
+        state.SetEnabled(GL_CULL_FACE, false);
+        state.DepthMask(true);
+        state.DepthFunc(GL_LESS);
+    }
+
+    size_t Size() const { return items.size(); }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> keys, scratch;
+    MultiDrawBatch batch;
+    const DrawUniforms *lastUniforms = nullptr;
+    const glm::mat4 *lastModel = nullptr;
+    int lastTransparency = 0;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float farPlane = 100.0f;
+
+    DrawItem &add(const DrawState &state, const glm::mat4 &model)
+    {
+        items.emplace_back();
+        DrawItem &item = items.back();
+        item.state = state;
+        item.model = model;
+        return item;
+    }
+
+    // program, fixed function state and per-draw uniforms of an item
+    void apply(const DrawItem &item)
+    {
+        GLState &state = GLState::Instance();
+        const DrawState &drawState = item.state;
+        drawState.shader->use();
+        state.SetEnabled(GL_CULL_FACE, drawState.cullBackFaces);
+        if (drawState.cullBackFaces)
+        {
+            state.FrontFace(drawState.frontFace);
+            state.CullFace(GL_BACK);
+        }
+        state.DepthMask(drawState.depthWrite);
+        state.DepthFunc(drawState.depthFunc);
+        // uniforms keep their values per program, so consecutive meshes of one model skip the upload
+        if (const DrawUniforms *uniforms = drawState.uniforms)
+        {
+            if (uniforms != lastUniforms || *lastModel != item.model)
+            {
+                uniforms->model.Set(item.model);
+                // once per object instead of an inverse per vertex
+                if (uniforms->normalMatrix.Valid())
+                    uniforms->normalMatrix.Set(NormalMatrix(item.model));
+            }
+            if (uniforms != lastUniforms || lastTransparency != drawState.transparency)
+                uniforms->transparency.Set(drawState.transparency);
+            lastUniforms = uniforms;
+            lastModel = &item.model;
+            lastTransparency = drawState.transparency;
+        }
+    }
+
+    // whether next can join the multi-draw of first: nothing apply() or the textures would set differently
+    static bool batches(const DrawItem &first, const DrawItem &next)
+    {
+        const DrawState &a = first.state, &b = next.state;
+        return next.mesh && !next.instances && a.shader == b.shader && a.uniforms == b.uniforms &&
+               a.transparency == b.transparency && a.cullBackFaces == b.cullBackFaces && a.frontFace == b.frontFace &&
+               a.depthWrite == b.depthWrite && a.depthFunc == b.depthFunc && first.model == next.model &&
+               first.mesh->SharesBatchWith(*next.mesh);
+    }
+
+    static void append(const DrawItem &item, MultiDrawBatch &batch)
+    {
+        if (item.clusters)
+            item.mesh->AppendClusters(batch, item.planes, item.viewer);
+        else
+            item.mesh->AppendLod(batch, item.lod);
+    }
+
+    uint64_t makeKey(const DrawState &state, GLuint material, GLuint vao, const glm::vec3 &center) const
+    {
+        const uint64_t depthMask = (1ull << DEPTH_BITS) - 1;
+        float distance = std::min(std::max(glm::length(center - cameraPosition) / farPlane, 0.0f), 1.0f);
+        uint64_t depth = (uint64_t)(distance * (float)depthMask);
+        uint64_t program = state.shader->ID & 0xFFu;
+        uint64_t stateBits = program << 32 | (uint64_t)(material & 0xFFFFu) << 16 | (vao & 0xFFFFu);
+        uint64_t key = (uint64_t)state.pass << 62;
+        switch (state.pass)
+        {
+            case RenderPass::Opaque: return key | stateBits << DEPTH_BITS | depth;
+            case RenderPass::Transparent: return key | (depthMask - depth) << 40 | stateBits;
+            default: return key | stateBits;
+        }
+    }
+
+    // LSD radix sort on 8-bit digits, stable so equal keys keep their submission order. Digits every key shares
+    // (most of them with a handful of programs and VAOs) are skipped without moving anything.
+    void sortKeys()
+    {
+        scratch.resize(keys.size());
+        for (unsigned int shift = 0; shift < 64 && keys.size() > 1; shift += 8)
+        {
+            size_t offsets[256] = {};
+            for (const SortEntry &entry : keys)
+                offsets[(entry.key >> shift) & 0xFF]++;
+            if (offsets[(keys[0].key >> shift) & 0xFF] == keys.size())
+                continue;
+            size_t sum = 0;
+            for (size_t &offset : offsets)
+            {
+                size_t count = offset;
+                offset = sum;
+                sum += count;
+            }
+            for (const SortEntry &entry : keys)
+                scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+            keys.swap(scratch);
+        }
+    }
+
+    static void drawRaw(const RawDraw &draw)
+    {
+        GLState &state = GLState::Instance();
+        for (unsigned int i = 0; i < draw.textureCount; i++)
+        {
+            const RawTexture &texture = draw.textures[i];
+            SetUniform(texture.samplerLocation, (int)texture.unit);
+            state.BindTexture(texture.unit, texture.target, texture.id);
+        }
+        state.BindVertexArray(draw.vao);
+        if (draw.indexed)
+            glDrawElements(GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, 0);
+        else
+            glDrawArrays(GL_TRIANGLES, 0, draw.count);
+        RenderStats::Frame().triangles += draw.count / 3;
+        RenderStats::Frame().drawCalls++;
+    }
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef RENDER_VIEW_H
+#define RENDER_VIEW_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/camera.h>
+
+// the camera as seen by culling and level of detail selection, captured once per frame
+struct RenderView {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 position;
+    float fovY;             // radians
+    float viewportHeight;   // pixels
+    float farPlane;
+
+    bool meshLod = true;            // draw coarser levels of detail where the difference is below a pixel
+    bool clusterCulling = true;     // skip the clusters of large meshes that are off screen or facing away
+
+    RenderView(Camera &camera, float aspect, float nearPlane, float farPlane, float viewportHeight)
+        : view(camera.GetViewMatrix()),
+          projection(glm::perspective(glm::radians(camera.Zoom), aspect, nearPlane, farPlane)),
+          position(camera.Position), fovY(glm::radians(camera.Zoom)), viewportHeight(viewportHeight),
+          farPlane(farPlane)
+    {
+    }
+};
+
+#endif
@@ -9,169 +9,267 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/startup_trace.h>
+#include <learnopengl/uniform.h>
+
+#include <chrono>
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly, or restores the linked program from the program binary cache.
+    // defines (e.g. "#define USE_NORMAL_MAP\n") are inserted after the #version line of every stage.
+    // Compiling and linking are only submitted here: no status is queried until the program is first used (or
+    // Finish() is called), so the driver can work on every program at once instead of one after another.
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* defines = nullptr)
     {
+        setupStart = std::chrono::steady_clock::now();
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
+        TraceScope trace("shader", "submit " + vertexPathString + " + " + fragmentPathString);
 
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
+        // 1. retrieve the vertex/fragment source code from filePath, out of the asset pack when it holds the files
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        AssetData vShaderFile;
+        AssetData fShaderFile;
+        AssetData gShaderFile;
+        if (vShaderFile.Open(vertexPath) && fShaderFile.Open(fragmentPath))
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            vertexCode = vShaderFile.String();
+            fragmentCode = fShaderFile.String();
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                if (gShaderFile.Open(geometryPath))
+                    geometryCode = gShaderFile.String();
+                else
+                    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
             }
         }
-        catch (std::ifstream::failure& e)
+        else
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        submit(vertexPathString + " + " + fragmentPathString,
+               vertexPathString + '|' + fragmentPathString + '|' + (geometryPath ? geometryPath : ""),
+               vertexCode, fragmentCode, geometryCode, defines);
+    }
+    // builds the program from sources in memory, for tools that generate their shaders. name stands in for the
+    // file paths in the program binary cache and in the load report, so it should be unique per program.
+    // ------------------------------------------------------------------------
+    static Shader FromSource(const std::string &name, const std::string &vertexCode, const std::string &fragmentCode, const char* defines = nullptr)
+    {
+        Shader shader;
+        shader.setupStart = std::chrono::steady_clock::now();
+        TraceScope trace("shader", "submit " + name);
+        shader.submit(name, name + "||", vertexCode, fragmentCode, std::string(), defines);
+        return shader;
+    }
+    // whether the program can be used without waiting for the driver. Never blocks: without
+    // KHR/ARB_parallel_shader_compile there is no way to ask, so a program is reported ready right away.
+    // ------------------------------------------------------------------------
+    bool Ready() const
+    {
+        if (finished || !GLExtensions().parallelShaderCompile)
+            return true;
+        GLint complete = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+    // waits for the link, reports errors, stores the program binary and releases the shader objects.
+    // use() calls it the first time, so calling it directly is only needed to pick the moment of the wait.
+    // ------------------------------------------------------------------------
+    void Finish()
+    {
+        if (finished)
+            return;
+        finished = true;
+        TraceScope trace("shader", "finish " + displayName);
+        if (!fromBinary)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            // a failed link is what points at the compile logs, a successful one means every stage compiled
+            if (checkCompileErrors(ID, "PROGRAM"))
+                ProgramCache::Store(ID, programName, programKey);
+            else
+            {
+                checkCompileErrors(vertex, "VERTEX");
+                checkCompileErrors(fragment, "FRAGMENT");
+                if (geometry != 0)
+                    checkCompileErrors(geometry, "GEOMETRY");
+            }
+            // delete the shaders as they're linked into our program now and no longer necessery
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            if (geometry != 0)
+                glDeleteShader(geometry);
+            vertex = fragment = geometry = 0;
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        // looked up once here, the set* functions and uniform handles never ask the driver again
+        uniformLocations = ReflectUniforms(ID);
+        BindUniformBlocks(ID);
+        double readyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+        std::cout << "SHADER::LOAD:: " << displayName << ": submitted in " << submitMs << " ms, ready after " << readyMs
+                  << " ms (" << (fromBinary ? "program binary" : "compiled from source") << ")" << std::endl;
+    }
+    bool Finished() const { return finished; }
+    // location of an active uniform, -1 for names the program does not use
+    // ------------------------------------------------------------------------
+    GLint UniformLocation(const std::string &name) const
+    {
+        // before Finish() the program may still be linking, ask the driver like before
+        if (!finished)
+            return glGetUniformLocation(ID, name.c_str());
+        auto found = uniformLocations.find(name);
+        return found != uniformLocations.end() ? found->second : -1;
+    }
+    // resolves a uniform once, for code that sets it every frame. Waits for the program to finish linking.
+    // ------------------------------------------------------------------------
+    template <typename T>
+    UniformHandle<T> Uniform(const std::string &name)
+    {
+        Finish();
+        return UniformHandle<T>(UniformLocation(name));
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        if (!finished)
+            Finish();
+        GLState::Instance().UseProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(UniformLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(UniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(UniformLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(UniformLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(UniformLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(UniformLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(UniformLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(UniformLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(UniformLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(UniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(UniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(UniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // compile/link state kept between the constructor and Finish()
+    unsigned int vertex = 0, fragment = 0, geometry = 0;
+    bool fromBinary = false;
+    bool finished = false;
+    std::string displayName;
+    std::string programName;
+    uint64_t programKey = 0;
+    std::chrono::steady_clock::time_point setupStart;
+    double submitMs = 0.0;
+    std::unordered_map<std::string, GLint> uniformLocations;
+
+    Shader() = default;
+
+    // compiles and links the stages (or restores the program binary); name is what the load report shows, sources
+    // identifies the stages in the program binary cache
+    // ------------------------------------------------------------------------
+    void submit(const std::string &name, const std::string &sources, std::string vertexCode, std::string fragmentCode,
+                std::string geometryCode, const char* defines)
+    {
+        std::string defineBlock = defines ? defines : "";
+        displayName = name;
+        programName = sources + '|' + defineBlock;
+        programKey = ProgramCache::Key({&vertexCode, &fragmentCode, &geometryCode}, defineBlock);
+        ID = ProgramCache::Load(programName, programKey);
+        fromBinary = ID != 0;
+        if (!fromBinary)
+        {
+            vertexCode = ProgramCache::WithDefines(vertexCode, defineBlock);
+            fragmentCode = ProgramCache::WithDefines(fragmentCode, defineBlock);
+            geometryCode = ProgramCache::WithDefines(geometryCode, defineBlock);
+            const char* vShaderCode = vertexCode.c_str();
+            const char * fShaderCode = fragmentCode.c_str();
+            // 2. compile shaders
+            // vertex shader
+            vertex = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(vertex, 1, &vShaderCode, NULL);
+            glCompileShader(vertex);
+            // fragment Shader
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fShaderCode, NULL);
+            glCompileShader(fragment);
+            // if geometry shader is given, compile geometry shader
+            if(!geometryCode.empty())
+            {
+                const char * gShaderCode = geometryCode.c_str();
+                geometry = glCreateShader(GL_GEOMETRY_SHADER);
+                glShaderSource(geometry, 1, &gShaderCode, NULL);
+                glCompileShader(geometry);
+            }
+            // shader Program
+            ID = glCreateProgram();
+            glAttachShader(ID, vertex);
+            glAttachShader(ID, fragment);
+            if(geometry != 0)
+                glAttachShader(ID, geometry);
+            ProgramCache::PrepareLink(ID);
+            glLinkProgram(ID);
+        }
+        submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    // returns whether compiling/linking succeeded
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +291,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
@@ -0,0 +1,81 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/shader.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// owns the programs of the scene and keeps their compilation off the critical path: Add() only submits the sources
+// to the driver, status is queried when a program is first used or, without blocking, from Poll(). With
+// KHR/ARB_parallel_shader_compile the driver is allowed all the compiler threads it has, so the programs build
+// side by side and startup is bound by the number of those threads instead of the number of programs.
+class ShaderManager
+{
+public:
+    ShaderManager()
+    {
+        // 0xFFFFFFFF lets the implementation pick its maximum
+        if (GLExtensions().parallelShaderCompile)
+            GLExtensions().MaxShaderCompilerThreads(0xFFFFFFFFu);
+    }
+
+    Shader &Add(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr, const char *defines = nullptr)
+    {
+        if (shaders.empty())
+            firstSubmit = std::chrono::steady_clock::now();
+        shaders.emplace_back(new Shader(vertexPath, fragmentPath, geometryPath, defines));
+        reported = false;
+        return *shaders.back();
+    }
+
+    // finishes the programs the driver is done with and returns how many are still compiling. Never waits; call once
+    // per frame. Without the parallel compile extension every program counts as done and is finished on the spot.
+    size_t Poll()
+    {
+        size_t pending = 0;
+        for (const std::unique_ptr<Shader> &shader : shaders)
+        {
+            if (shader->Finished())
+                continue;
+            if (shader->Ready())
+                shader->Finish();
+            else
+                pending++;
+        }
+        if (pending == 0)
+            report();
+        return pending;
+    }
+
+    // blocks until every program is linked
+    void FinishAll()
+    {
+        for (const std::unique_ptr<Shader> &shader : shaders)
+            shader->Finish();
+        report();
+    }
+
+    size_t Count() const { return shaders.size(); }
+
+private:
+    std::vector<std::unique_ptr<Shader>> shaders;
+    std::chrono::steady_clock::time_point firstSubmit;
+    bool reported = false;
+
+    void report()
+    {
+        if (reported || shaders.empty())
+            return;
+        reported = true;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - firstSubmit).count();
+        std::cout << "SHADERS:: " << shaders.size() << " programs ready " << ms << " ms after the first submit ("
+                  << (GLExtensions().parallelShaderCompile ? "parallel driver compile" : "serial driver compile") << ")"
+                  << std::endl;
+    }
+};
+
+#endif
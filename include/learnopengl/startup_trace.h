@@ -0,0 +1,221 @@
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// records where startup time goes as nested, named scopes on any thread:
+//
+//     TraceScope scope("model", "import " + path);
+//
+// a scope is recorded when it ends, with its start, duration, thread and nesting depth on that thread. Recording stops
+// with Stop() (once the first frame with every asset is drawn), later scopes cost one atomic load. The events are
+// written as a JSON report and in the Chrome trace event format (load in chrome://tracing or ui.perfetto.dev), so the
+// numbers of two builds can be compared.
+struct TraceEvent
+{
+    std::string name;
+    const char *category;
+    uint32_t thread;
+    uint32_t depth;
+    int64_t startMicros;
+    int64_t durationMicros;
+};
+
+class StartupTrace
+{
+public:
+    static StartupTrace &Instance()
+    {
+        static StartupTrace trace;
+        return trace;
+    }
+
+    // microseconds since the tracer was first used; touch it first thing in main() to make that the origin
+    int64_t Now() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    bool Recording() const { return recording.load(std::memory_order_relaxed); }
+
+    void Stop()
+    {
+        if (recording.exchange(false))
+            stopMicros = Now();
+    }
+
+    void Record(TraceEvent &&event)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(std::move(event));
+    }
+
+    // small sequential id of the calling thread, 0 for the first thread that traces (the main thread)
+    uint32_t ThreadIndex()
+    {
+        thread_local uint32_t index = nextThread++;
+        return index;
+    }
+
+    // nesting depth of the open scopes on the calling thread
+    static uint32_t &Depth()
+    {
+        thread_local uint32_t depth = 0;
+        return depth;
+    }
+
+    // {"totalMs", "threads", "categories": {category: summed ms of its outermost scopes}, "events": [...]}
+    bool WriteReport(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+            return false;
+        std::vector<std::pair<const char *, int64_t>> categories;
+        std::vector<bool> nested = nestedEvents();
+        for (size_t e = 0; e < events.size(); e++)
+        {
+            const TraceEvent &event = events[e];
+            if (nested[e])
+                continue;
+            size_t i = 0;
+            while (i < categories.size() && std::string(categories[i].first) != event.category)
+                i++;
+            if (i == categories.size())
+                categories.push_back({event.category, 0});
+            categories[i].second += event.durationMicros;
+        }
+        std::fprintf(f, "{\n  \"version\": 1,\n  \"totalMs\": %.3f,\n  \"threads\": %u,\n  \"categories\": {",
+                     (Recording() ? Now() : stopMicros) / 1000.0, nextThread.load());
+        for (size_t i = 0; i < categories.size(); i++)
+            std::fprintf(f, "%s\n    \"%s\": %.3f", i ? "," : "", categories[i].first, categories[i].second / 1000.0);
+        std::fprintf(f, "\n  },\n  \"events\": [");
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            const TraceEvent &event = events[i];
+            std::fprintf(f, "%s\n    {\"name\": \"%s\", \"category\": \"%s\", \"thread\": %u, \"depth\": %u, \"startMs\": %.3f, \"durationMs\": %.3f}",
+                         i ? "," : "", escape(event.name).c_str(), event.category, event.thread, event.depth,
+                         event.startMicros / 1000.0, event.durationMicros / 1000.0);
+        }
+        std::fprintf(f, "\n  ]\n}\n");
+        return std::fclose(f) == 0;
+    }
+
+    // complete ("X") events in the Chrome trace event format, one row per thread
+    bool WriteChromeTrace(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        FILE *f = std::fopen(path.c_str(), "w");
+        if (!f)
+            return false;
+        std::fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+        for (uint32_t thread = 0; thread < nextThread.load(); thread++)
+            std::fprintf(f, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s %u\"}}",
+                         thread ? "," : "", thread, thread == 0 ? "main" : "worker", thread);
+        for (const TraceEvent &event : events)
+            std::fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %lld, \"dur\": %lld}",
+                         escape(event.name).c_str(), event.category, event.thread, (long long)event.startMicros,
+                         (long long)event.durationMicros);
+        std::fprintf(f, "\n]}\n");
+        return std::fclose(f) == 0;
+    }
+
+private:
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::atomic<bool> recording{true};
+    std::atomic<uint32_t> nextThread{0};
+    int64_t stopMicros = 0;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+
+    StartupTrace() = default;
+
+    // for every event whether it lies inside another event of the same category on its thread, so it is not summed
+    // twice. A thread records its scopes as they end, children before their parent, so walking each thread's events
+    // backwards meets every scope right after the ones enclosing it, which are kept on a stack.
+    std::vector<bool> nestedEvents() const
+    {
+        std::vector<size_t> order(events.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return events[a].thread < events[b].thread; });
+
+        std::vector<bool> nested(events.size(), false);
+        std::vector<size_t> open;
+        for (size_t k = order.size(); k-- > 0;)
+        {
+            const TraceEvent &event = events[order[k]];
+            while (!open.empty() && (events[open.back()].thread != event.thread || events[open.back()].depth >= event.depth))
+                open.pop_back();
+            for (size_t j : open)
+                if (std::strcmp(events[j].category, event.category) == 0)
+                    nested[order[k]] = true;
+            open.push_back(order[k]);
+        }
+        return nested;
+    }
+
+    static std::string escape(const std::string &text)
+    {
+        std::string out;
+        out.reserve(text.size());
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if ((unsigned char)c < 0x20)
+                continue;
+            out += c;
+        }
+        return out;
+    }
+};
+
+// records the time from construction to destruction (or End()). category must be a string literal.
+class TraceScope
+{
+public:
+    TraceScope(const char *category, std::string name)
+    {
+        StartupTrace &trace = StartupTrace::Instance();
+        if (!trace.Recording())
+            return;
+        active = true;
+        event.name = std::move(name);
+        event.category = category;
+        event.thread = trace.ThreadIndex();
+        event.depth = StartupTrace::Depth()++;
+        event.startMicros = trace.Now();
+    }
+
+    ~TraceScope() { End(); }
+
+    // ends the scope before its destructor runs
+    void End()
+    {
+        if (!active)
+            return;
+        active = false;
+        StartupTrace &trace = StartupTrace::Instance();
+        StartupTrace::Depth()--;
+        event.durationMicros = trace.Now() - event.startMicros;
+        trace.Record(std::move(event));
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    TraceEvent event;
+    bool active = false;
+};
+
+#endif
@@ -0,0 +1,581 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+// CPU encoder/decoder for the S3TC/RGTC block formats and the .ctex container holding a precomputed mip chain.
+// no GL in here, so the offline transcoder can use it without a context.
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+enum class BlockFormat : uint32_t
+{
+    BC1 = 1,    // RGB, 4 bpp (DXT1)
+    BC3 = 3,    // RGBA, 8 bpp (DXT5)
+    BC4 = 4,    // R, 4 bpp (RGTC1)
+    BC5 = 5     // RG, 8 bpp (RGTC2)
+};
+
+inline unsigned int BlockBytes(BlockFormat format)
+{
+    return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+}
+
+inline const char *BlockFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+        case BlockFormat::BC1: return "BC1";
+        case BlockFormat::BC3: return "BC3";
+        case BlockFormat::BC4: return "BC4";
+        case BlockFormat::BC5: return "BC5";
+    }
+    return "unknown";
+}
+
+// format used when the transcoder is not told otherwise, matching what TextureFromFile would upload uncompressed.
+inline BlockFormat DefaultBlockFormat(int components)
+{
+    if (components == 1)
+        return BlockFormat::BC4;
+    if (components == 3)
+        return BlockFormat::BC1;
+    return BlockFormat::BC3;
+}
+
+struct CompressedMip
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<unsigned char> data;
+};
+
+struct CompressedImage
+{
+    BlockFormat format;
+    std::vector<CompressedMip> mips;    // level 0 first, down to 1x1
+};
+
+namespace bc {
+
+// expands one texel of a stb_image style buffer (1 to 4 components) to RGBA
+inline void FetchRGBA(const unsigned char *pixels, int components, size_t index, unsigned char rgba[4])
+{
+    const unsigned char *p = pixels + index * components;
+    switch (components)
+    {
+        case 1: rgba[0] = rgba[1] = rgba[2] = p[0]; rgba[3] = 255; break;
+        case 2: rgba[0] = rgba[1] = rgba[2] = p[0]; rgba[3] = p[1]; break;
+        case 3: rgba[0] = p[0]; rgba[1] = p[1]; rgba[2] = p[2]; rgba[3] = 255; break;
+        default: rgba[0] = p[0]; rgba[1] = p[1]; rgba[2] = p[2]; rgba[3] = p[3]; break;
+    }
+}
+
+inline uint16_t PackRGB565(const float c[3])
+{
+    int r = std::min(31, std::max(0, (int)std::lround(c[0] * 31.0f / 255.0f)));
+    int g = std::min(63, std::max(0, (int)std::lround(c[1] * 63.0f / 255.0f)));
+    int b = std::min(31, std::max(0, (int)std::lround(c[2] * 31.0f / 255.0f)));
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void UnpackRGB565(uint16_t c, int out[3])
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// the four colors a BC1 block in four-color mode can represent
+inline void BC1Palette(uint16_t c0, uint16_t c1, int palette[4][3])
+{
+    UnpackRGB565(c0, palette[0]);
+    UnpackRGB565(c1, palette[1]);
+    for (int k = 0; k < 3; k++)
+    {
+        palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+        palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+    }
+}
+
+// picks the closest palette entry for every texel, returns the packed indices and the summed squared error
+inline uint32_t BC1Indices(const unsigned char block[16][4], const int palette[4][3], int &error)
+{
+    uint32_t indices = 0;
+    error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestDistance = 1 << 30;
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= (uint32_t)best << (2 * i);
+        error += bestDistance;
+    }
+    return indices;
+}
+
+inline void WriteBC1(unsigned char *out, uint16_t c0, uint16_t c1, uint32_t indices)
+{
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// encodes the RGB part of a 4x4 block. Endpoints come from the principal axis of the block colors,
+// followed by one least-squares refit of the endpoints to the chosen indices. Always uses four-color mode.
+inline void EncodeBC1Block(const unsigned char block[16][4], unsigned char out[8])
+{
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 3; k++)
+            mean[k] += block[i][k] / 16.0f;
+
+    float cov[6] = {0, 0, 0, 0, 0, 0}; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++)
+    {
+        float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    // power iteration for the dominant eigenvector
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+    }
+
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float endA[3], endB[3];
+    for (int k = 0; k < 3; k++)
+    {
+        endA[k] = mean[k] + axis[k] * maxProjection / std::max(axisLength2, 1e-6f);
+        endB[k] = mean[k] + axis[k] * minProjection / std::max(axisLength2, 1e-6f);
+    }
+
+    uint16_t c0 = PackRGB565(endA), c1 = PackRGB565(endB);
+    if (c0 < c1)
+        std::swap(c0, c1);
+    int palette[4][3];
+    BC1Palette(c0, c1, palette);
+    int error;
+    uint32_t indices = BC1Indices(block, palette, error);
+
+    // least-squares refit: solve for the endpoints that best reproduce the texels with the chosen weights
+    if (c0 != c1)
+    {
+        static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0, ab = 0, bb = 0, ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++)
+        {
+            float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+            aa += a * a; ab += a * b; bb += b * b;
+            for (int k = 0; k < 3; k++)
+            {
+                ax[k] += a * block[i][k];
+                bx[k] += b * block[i][k];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) > 1e-6f)
+        {
+            float refitA[3], refitB[3];
+            for (int k = 0; k < 3; k++)
+            {
+                refitA[k] = std::min(255.0f, std::max(0.0f, (ax[k] * bb - bx[k] * ab) / determinant));
+                refitB[k] = std::min(255.0f, std::max(0.0f, (bx[k] * aa - ax[k] * ab) / determinant));
+            }
+            uint16_t r0 = PackRGB565(refitA), r1 = PackRGB565(refitB);
+            if (r0 < r1)
+                std::swap(r0, r1);
+            if (r0 != r1)
+            {
+                int refitPalette[4][3];
+                BC1Palette(r0, r1, refitPalette);
+                int refitError;
+                uint32_t refitIndices = BC1Indices(block, refitPalette, refitError);
+                if (refitError < error)
+                {
+                    c0 = r0;
+                    c1 = r1;
+                    indices = refitIndices;
+                }
+            }
+        }
+    }
+    if (c0 == c1)
+        indices = 0;
+    WriteBC1(out, c0, c1, indices);
+}
+
+inline void BC4Palette(int v0, int v1, int palette[8])
+{
+    palette[0] = v0;
+    palette[1] = v1;
+    if (v0 > v1)
+    {
+        for (int k = 1; k <= 6; k++)
+            palette[k + 1] = ((7 - k) * v0 + k * v1) / 7;
+    }
+    else
+    {
+        for (int k = 1; k <= 4; k++)
+            palette[k + 1] = ((5 - k) * v0 + k * v1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// encodes one channel of a 4x4 block in the eight-value mode (min/max endpoints), as used by BC3 alpha, BC4 and BC5
+inline void EncodeBC4Block(const unsigned char block[16][4], int channel, unsigned char out[8])
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, (int)block[i][channel]);
+        hi = std::max(hi, (int)block[i][channel]);
+    }
+    out[0] = (unsigned char)hi;
+    out[1] = (unsigned char)lo;
+    uint64_t indices = 0;
+    if (hi > lo)
+    {
+        int palette[8];
+        BC4Palette(hi, lo, palette);
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs((int)block[i][channel] - palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+inline void DecodeBC1Block(const unsigned char *in, unsigned char block[16][4])
+{
+    uint16_t c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+    uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+    int palette[4][3];
+    BC1Palette(c0, c1, palette);
+    for (int i = 0; i < 16; i++)
+    {
+        int p = (indices >> (2 * i)) & 3;
+        for (int k = 0; k < 3; k++)
+            block[i][k] = (unsigned char)palette[p][k];
+    }
+}
+
+inline void DecodeBC4Block(const unsigned char *in, int channel, unsigned char block[16][4])
+{
+    int palette[8];
+    BC4Palette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (uint64_t)in[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        block[i][channel] = (unsigned char)palette[(indices >> (3 * i)) & 7];
+}
+
+} // namespace bc
+
+// encodes one mip level. pixels is a tightly packed stb_image style buffer with 1 to 4 components.
+// edge blocks of sizes that are not a multiple of 4 repeat the last row/column.
+inline std::vector<unsigned char> EncodeBlocks(const unsigned char *pixels, int width, int height, int components, BlockFormat format)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    std::vector<unsigned char> out((size_t)blocksX * blocksY * BlockBytes(format));
+    unsigned char *dst = out.data();
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            unsigned char block[16][4];
+            for (int i = 0; i < 16; i++)
+            {
+                int x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+                bc::FetchRGBA(pixels, components, (size_t)y * width + x, block[i]);
+            }
+            switch (format)
+            {
+                case BlockFormat::BC1:
+                    bc::EncodeBC1Block(block, dst);
+                    break;
+                case BlockFormat::BC3:
+                    bc::EncodeBC4Block(block, 3, dst);
+                    bc::EncodeBC1Block(block, dst + 8);
+                    break;
+                case BlockFormat::BC4:
+                    bc::EncodeBC4Block(block, 0, dst);
+                    break;
+                case BlockFormat::BC5:
+                    bc::EncodeBC4Block(block, 0, dst);
+                    bc::EncodeBC4Block(block, 1, dst + 8);
+                    break;
+            }
+            dst += BlockBytes(format);
+        }
+    }
+    return out;
+}
+
+// decodes one mip level back to RGBA8. Channels the format does not store are 0 (alpha 255).
+inline std::vector<unsigned char> DecodeBlocks(const unsigned char *blocks, int width, int height, BlockFormat format)
+{
+    std::vector<unsigned char> rgba((size_t)width * height * 4);
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    const unsigned char *src = blocks;
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            unsigned char block[16][4];
+            memset(block, 0, sizeof(block));
+            for (int i = 0; i < 16; i++)
+                block[i][3] = 255;
+            switch (format)
+            {
+                case BlockFormat::BC1: bc::DecodeBC1Block(src, block); break;
+                case BlockFormat::BC3: bc::DecodeBC4Block(src, 3, block); bc::DecodeBC1Block(src + 8, block); break;
+                case BlockFormat::BC4: bc::DecodeBC4Block(src, 0, block); break;
+                case BlockFormat::BC5: bc::DecodeBC4Block(src, 0, block); bc::DecodeBC4Block(src + 8, 1, block); break;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x < width && y < height)
+                    memcpy(&rgba[((size_t)y * width + x) * 4], block[i], 4);
+            }
+            src += BlockBytes(format);
+        }
+    }
+    return rgba;
+}
+
+// PSNR in dB between the source image and its encoded version, over the channels the format stores.
+inline double MeasurePSNR(const unsigned char *pixels, int width, int height, int components,
+                          const unsigned char *blocks, BlockFormat format)
+{
+    std::vector<unsigned char> decoded = DecodeBlocks(blocks, width, height, format);
+    int channels = format == BlockFormat::BC1 ? 3 : format == BlockFormat::BC3 ? 4 : format == BlockFormat::BC4 ? 1 : 2;
+    double squaredError = 0.0;
+    for (size_t i = 0; i < (size_t)width * height; i++)
+    {
+        unsigned char source[4];
+        bc::FetchRGBA(pixels, components, i, source);
+        for (int k = 0; k < channels; k++)
+        {
+            double d = (double)source[k] - decoded[i * 4 + k];
+            squaredError += d * d;
+        }
+    }
+    double mse = squaredError / ((double)width * height * channels);
+    return mse <= 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// halves an image with a 2x2 box filter (odd sizes clamp to the last row/column)
+inline std::vector<unsigned char> DownsampleImage(const unsigned char *pixels, int width, int height, int components, int &outWidth, int &outHeight)
+{
+    outWidth = std::max(1, width / 2);
+    outHeight = std::max(1, height / 2);
+    std::vector<unsigned char> out((size_t)outWidth * outHeight * components);
+    for (int y = 0; y < outHeight; y++)
+    {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < outWidth; x++)
+        {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int k = 0; k < components; k++)
+            {
+                int sum = pixels[((size_t)y0 * width + x0) * components + k] + pixels[((size_t)y0 * width + x1) * components + k] +
+                          pixels[((size_t)y1 * width + x0) * components + k] + pixels[((size_t)y1 * width + x1) * components + k];
+                out[((size_t)y * outWidth + x) * components + k] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return out;
+}
+
+// encodes the full mip chain of an image
+inline CompressedImage CompressImage(const unsigned char *pixels, int width, int height, int components, BlockFormat format)
+{
+    CompressedImage image;
+    image.format = format;
+    std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * components);
+    for (;;)
+    {
+        CompressedMip mip;
+        mip.width = (uint32_t)width;
+        mip.height = (uint32_t)height;
+        mip.data = EncodeBlocks(level.data(), width, height, components, format);
+        image.mips.push_back(std::move(mip));
+        if (width == 1 && height == 1)
+            break;
+        level = DownsampleImage(level.data(), width, height, components, width, height);
+    }
+    return image;
+}
+
+// .ctex container, written next to the source image as <image>.ctex:
+//   CompressedTextureHeader
+//   CompressedMipRecord[mipCount]
+//   block data of every level, aligned to 16 bytes
+const uint32_t COMPRESSED_TEXTURE_VERSION = 1;
+
+struct CompressedTextureHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint32_t mipCount;
+    uint32_t reserved;
+    uint64_t sourceSize;     // the container is stale once the source image changes
+    int64_t  sourceMtime;
+};
+
+struct CompressedMipRecord
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+inline std::string CompressedTexturePath(const std::string &sourcePath)
+{
+    return sourcePath + ".ctex";
+}
+
+inline bool WriteCompressedTexture(const std::string &sourcePath, const CompressedImage &image)
+{
+    struct stat st;
+    if (stat(sourcePath.c_str(), &st) != 0)
+        return false;
+
+    CompressedTextureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LOGLTEX", 8);
+    header.version = COMPRESSED_TEXTURE_VERSION;
+    header.format = (uint32_t)image.format;
+    header.mipCount = (uint32_t)image.mips.size();
+    header.sourceSize = (uint64_t)st.st_size;
+    header.sourceMtime = (int64_t)st.st_mtime;
+
+    std::vector<CompressedMipRecord> records(image.mips.size());
+    uint64_t offset = (sizeof(header) + records.size() * sizeof(CompressedMipRecord) + 15) & ~(uint64_t)15;
+    for (size_t i = 0; i < image.mips.size(); i++)
+    {
+        records[i].width = image.mips[i].width;
+        records[i].height = image.mips[i].height;
+        records[i].offset = offset;
+        records[i].size = image.mips[i].data.size();
+        offset = (offset + records[i].size + 15) & ~(uint64_t)15;
+    }
+
+    std::string path = CompressedTexturePath(sourcePath);
+    std::string tmpPath = path + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (!records.empty())
+        ok = ok && fwrite(records.data(), sizeof(CompressedMipRecord), records.size(), f) == records.size();
+    for (size_t i = 0; ok && i < image.mips.size(); i++)
+    {
+        ok = fseek(f, (long)records[i].offset, SEEK_SET) == 0 &&
+             fwrite(image.mips[i].data.data(), 1, image.mips[i].data.size(), f) == image.mips[i].data.size();
+    }
+    // pad the last level so the file size matches the alignment used for the offsets
+    static const unsigned char padding[16] = {0};
+    if (ok)
+    {
+        size_t paddingSize = (size_t)(offset - (uint64_t)ftell(f));
+        ok = fwrite(padding, 1, paddingSize, f) == paddingSize;
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// loads the .ctex next to sourcePath if it exists and still matches the source image.
+inline bool ReadCompressedTexture(const std::string &sourcePath, CompressedImage &image)
+{
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    if (!StatAsset(sourcePath, sourceSize, sourceMtime))
+        return false;
+    AssetData file;
+    if (!file.Open(CompressedTexturePath(sourcePath)) || file.Size() < sizeof(CompressedTextureHeader))
+        return false;
+
+    CompressedTextureHeader header;
+    memcpy(&header, file.Data(), sizeof(header));
+    if (memcmp(header.magic, "LOGLTEX", 8) != 0 || header.version != COMPRESSED_TEXTURE_VERSION ||
+        header.sourceSize != sourceSize || header.sourceMtime != sourceMtime ||
+        header.format < 1 || header.format > 5 || header.format == 2 || header.mipCount == 0 ||
+        sizeof(header) + (uint64_t)header.mipCount * sizeof(CompressedMipRecord) > file.Size())
+        return false;
+
+    image.format = (BlockFormat)header.format;
+    image.mips.clear();
+    for (uint32_t i = 0; i < header.mipCount; i++)
+    {
+        CompressedMipRecord record;
+        memcpy(&record, file.Data() + sizeof(header) + i * sizeof(CompressedMipRecord), sizeof(record));
+        uint64_t expected = (uint64_t)((record.width + 3) / 4) * ((record.height + 3) / 4) * BlockBytes(image.format);
+        if (record.size != expected || record.offset > file.Size() || record.size > file.Size() - record.offset)
+            return false;
+        CompressedMip mip;
+        mip.width = record.width;
+        mip.height = record.height;
+        mip.data.assign(file.Data() + record.offset, file.Data() + record.offset + record.size);
+        image.mips.push_back(std::move(mip));
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/startup_trace.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a texture whose image is decoded in the background. id is valid immediately and samples as a 1x1 white fallback
+// until the real image is uploaded and ready is set.
+struct AsyncTexture
+{
+    unsigned int id = 0;
+    GLenum target = GL_TEXTURE_2D;
+    std::string path;               // first face for cubemaps
+    std::atomic<bool> ready{false};
+    std::atomic<int> pendingImages{0};
+    bool failed = false;
+    bool compressed = false;        // uploaded from a .ctex container with its precomputed mip chain
+    double decodeMs = 0.0;          // summed over all images (faces) of the texture
+    double uploadMs = 0.0;
+    size_t bytes = 0;               // uploaded size of level 0 (block data for compressed textures)
+};
+typedef std::shared_ptr<AsyncTexture> TextureHandle;
+
+// multi-producer/single-consumer queue without locks: workers push with a CAS on the head,
+// the GL thread takes the whole list at once and restores the submission order.
+// items are allocated with new; the queue owns the ones still in it and deletes them when it is destroyed.
+template<typename T>
+class LockFreeQueue
+{
+public:
+    LockFreeQueue() = default;
+    LockFreeQueue(const LockFreeQueue &) = delete;
+    LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+    ~LockFreeQueue()
+    {
+        T *item = PopAll();
+        while (item)
+        {
+            T *next = item->next;
+            delete item;
+            item = next;
+        }
+    }
+
+    // T must have a "T *next" member
+    void Push(T *item)
+    {
+        T *head = top.load(std::memory_order_relaxed);
+        do
+        {
+            item->next = head;
+        } while (!top.compare_exchange_weak(head, item, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // takes every queued item, oldest first. The returned list is owned by the caller.
+    T *PopAll()
+    {
+        T *list = top.exchange(nullptr, std::memory_order_acquire);
+        T *reversed = nullptr;
+        while (list)
+        {
+            T *next = list->next;
+            list->next = reversed;
+            reversed = list;
+            list = next;
+        }
+        return reversed;
+    }
+
+private:
+    std::atomic<T *> top{nullptr};
+};
+
+// decodes images on worker threads and uploads them on the GL thread.
+// Load2D/LoadCubemap must be called on the GL thread, they return right away; ProcessUploads()/Finish() complete the textures.
+class TextureLoader
+{
+public:
+    static TextureLoader &Instance()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    // prefers the block-compressed <path>.ctex written by the texture_transcoder tool when it is up to date
+    // and the driver supports its format, otherwise decodes the image itself.
+    TextureHandle Load2D(const std::string &path)
+    {
+        TextureHandle texture = create(GL_TEXTURE_2D, path, 1);
+        submit(texture, GL_TEXTURE_2D, path, true);
+        return texture;
+    }
+
+    // faces in the GL order: +X, -X, +Y, -Y, +Z, -Z
+    TextureHandle LoadCubemap(const std::vector<std::string> &faces)
+    {
+        TextureHandle texture = create(GL_TEXTURE_CUBE_MAP, faces.empty() ? std::string() : faces[0], (int)faces.size());
+        for (unsigned int i = 0; i < faces.size(); i++)
+            submit(texture, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i], false);
+        return texture;
+    }
+
+    // uploads every image decoded so far. Call once per frame or in a loop while waiting.
+    unsigned int ProcessUploads()
+    {
+        unsigned int count = 0;
+        DecodedImage *image = decoded.PopAll();
+        while (image)
+        {
+            DecodedImage *next = image->next;
+            upload(*image);
+            delete image;
+            image = next;
+            count++;
+        }
+        return count;
+    }
+
+    // blocks until every requested texture is uploaded, then prints per texture timings and the overall throughput.
+    void Finish()
+    {
+        while (inFlight.load() > 0)
+        {
+            if (ProcessUploads() == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        ProcessUploads();
+        PrintStats();
+    }
+
+    // whether some requested image is still being decoded or waiting for upload
+    bool Busy() const { return inFlight.load() > 0; }
+
+    // 1x1 white texture, bound in place of textures that are not loaded at all (e.g. by proxy meshes)
+    unsigned int FallbackTexture()
+    {
+        if (fallback == 0)
+        {
+            glGenTextures(1, &fallback);
+            setFallbackImage(GL_TEXTURE_2D, fallback);
+        }
+        return fallback;
+    }
+
+    // prints per texture timings and the overall throughput of the textures requested since the last call.
+    void PrintStats()
+    {
+        if (textures.empty())
+            return;
+        double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+        double decodeMs = 0.0, uploadMs = 0.0;
+        size_t bytes = 0;
+        for (const TextureHandle &texture : textures)
+        {
+            std::cout << "TEXTURE::LOAD:: " << texture->path << (texture->compressed ? " (compressed)" : "") << ": decode " << texture->decodeMs << " ms, upload "
+                      << texture->uploadMs << " ms" << std::endl;
+            decodeMs += texture->decodeMs;
+            uploadMs += texture->uploadMs;
+            bytes += texture->bytes;
+        }
+        double megabytes = bytes / (1024.0 * 1024.0);
+        std::cout << "TEXTURE::LOADER:: " << textures.size() << " textures, " << megabytes << " MB uploaded on "
+                  << pool.ThreadCount() << " threads in " << wallMs << " ms wall (" << decodeMs << " ms summed decode, "
+                  << uploadMs << " ms upload), " << (wallMs > 0.0 ? megabytes * 1000.0 / wallMs : 0.0) << " MB/s" << std::endl;
+        textures.clear();
+    }
+
+private:
+    // owns its pixels, so an image still queued when the loader goes away at exit is freed with the queue
+    struct DecodedImage
+    {
+        ~DecodedImage()
+        {
+            stbi_image_free(pixels);
+        }
+
+        TextureHandle texture;
+        GLenum target;
+        std::string path;
+        unsigned char *pixels;
+        int width, height, components;
+        bool isCompressed;
+        CompressedImage compressed;
+        double decodeMs;
+        DecodedImage *next;
+    };
+
+    LockFreeQueue<DecodedImage> decoded;
+    std::atomic<int> inFlight{0};
+    std::vector<TextureHandle> textures;   // textures requested since the last Finish(), for the report
+    std::chrono::steady_clock::time_point batchStart;
+    int supportsS3TC = -1;                  // queried on the GL thread on first use
+    unsigned int fallback = 0;
+    // declared last so the workers are joined before the queue they push into is destroyed, which then frees the
+    // images decoded after the last ProcessUploads()
+    ThreadPool pool;
+
+    TextureLoader() = default;
+
+    TextureHandle create(GLenum target, const std::string &path, int images)
+    {
+        TextureHandle texture = std::make_shared<AsyncTexture>();
+        glGenTextures(1, &texture->id);
+        setFallbackImage(target, texture->id);
+        texture->target = target;
+        texture->path = path;
+        texture->pendingImages = images;
+        if (textures.empty())
+            batchStart = std::chrono::steady_clock::now();
+        textures.push_back(texture);
+        return texture;
+    }
+
+    void submit(TextureHandle texture, GLenum target, const std::string &path, bool allowCompressed)
+    {
+        if (supportsS3TC < 0)
+            supportsS3TC = HasGLExtension("GL_EXT_texture_compression_s3tc") ? 1 : 0;
+        bool s3tc = supportsS3TC == 1;
+        inFlight++;
+        pool.Submit([this, texture, target, path, allowCompressed, s3tc] {
+            auto start = std::chrono::steady_clock::now();
+            TraceScope trace("texture", "decode " + path);
+            DecodedImage *image = new DecodedImage();
+            image->texture = texture;
+            image->target = target;
+            image->path = path;
+            image->pixels = nullptr;
+            // RGTC (BC4/BC5) is core since GL 3.0, S3TC (BC1/BC3) needs the extension
+            image->isCompressed = allowCompressed && ReadCompressedTexture(path, image->compressed) &&
+                                  (s3tc || image->compressed.format == BlockFormat::BC4 || image->compressed.format == BlockFormat::BC5);
+            if (!image->isCompressed)
+            {
+                AssetData file;
+                if (file.Open(path))
+                    image->pixels = stbi_load_from_memory(file.Data(), (int)file.Size(), &image->width, &image->height, &image->components, 0);
+            }
+            image->decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            decoded.Push(image);
+        });
+    }
+
+    void upload(DecodedImage &image)
+    {
+        AsyncTexture &texture = *image.texture;
+        auto start = std::chrono::steady_clock::now();
+        TraceScope trace("texture", "upload " + image.path);
+        if (image.isCompressed)
+        {
+            GLenum internalFormat = compressedFormat(image.compressed.format);
+            GLState::Instance().BindTexture(texture.target, texture.id);
+            for (unsigned int level = 0; level < image.compressed.mips.size(); level++)
+            {
+                const CompressedMip &mip = image.compressed.mips[level];
+                glCompressedTexImage2D(image.target, level, internalFormat, mip.width, mip.height, 0, (GLsizei)mip.data.size(), mip.data.data());
+            }
+            glTexParameteri(texture.target, GL_TEXTURE_MAX_LEVEL, (GLint)image.compressed.mips.size() - 1);
+            texture.bytes += image.compressed.mips[0].data.size();
+            texture.compressed = true;
+        }
+        else if (image.pixels)
+        {
+            GLenum format = GL_RGB;
+            if (image.components == 1)
+                format = GL_RED;
+            else if (image.components == 2)
+                format = GL_RG;
+            else if (image.components == 3)
+                format = GL_RGB;
+            else if (image.components == 4)
+                format = GL_RGBA;
+
+            GLState::Instance().BindTexture(texture.target, texture.id);
+            glTexImage2D(image.target, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+            texture.bytes += (size_t)image.width * image.height * image.components;
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+            texture.failed = true;
+        }
+        stbi_image_free(image.pixels);
+        image.pixels = nullptr;
+
+        // the last image of the texture sets the sampling state
+        if (--texture.pendingImages == 0)
+        {
+            GLState::Instance().BindTexture(texture.target, texture.id);
+            if (texture.target == GL_TEXTURE_CUBE_MAP)
+            {
+                // a cubemap is only complete with six square faces of one size, so a face that failed to load
+                // takes the others back to the 1x1 fallback instead of leaving the texture unsampleable
+                if (texture.failed)
+                {
+                    setFallbackImage(GL_TEXTURE_CUBE_MAP, texture.id);
+                    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+                    texture.bytes = 0;
+                    texture.compressed = false;
+                }
+                glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            }
+            else if (!texture.failed)
+            {
+                if (!texture.compressed)
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            }
+        }
+        texture.decodeMs += image.decodeMs;
+        texture.uploadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (texture.pendingImages == 0)
+            texture.ready = true;
+        inFlight--;
+    }
+
+    // makes the texture complete with a single white texel, so it can be sampled before its image arrives
+    static void setFallbackImage(GLenum target, unsigned int id)
+    {
+        static const unsigned char white[4] = {255, 255, 255, 255};
+        GLState::Instance().BindTexture(target, id);
+        if (target == GL_TEXTURE_CUBE_MAP)
+        {
+            for (unsigned int i = 0; i < 6; i++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+        }
+        else
+            glTexImage2D(target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    static GLenum compressedFormat(BlockFormat format)
+    {
+        switch (format)
+        {
+            case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+            case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+        }
+        return GL_NONE;
+    }
+};
+
+#endif
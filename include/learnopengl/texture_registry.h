@@ -0,0 +1,203 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/texture_loader.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// process-wide cache of GL textures shared by every Model and by the textures main() loads itself.
+// a texture is found by its canonical path first and by a hash of its file contents second, so the same image
+// reached through another relative path or copied into another folder is decoded and uploaded only once.
+// the returned ids are refcounted: every Acquire must be paired with a Release once the caller is done with it.
+// reading and hashing a file is too slow for the GL thread while streaming, so importers hash their textures with
+// HashFile()/HashFaces() on their worker and hand the result to Acquire; without it Acquire hashes the files itself.
+class TextureRegistry
+{
+public:
+    static TextureRegistry &Instance()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // hash of the contents of a texture file, fileBytes is set to its size or 0 when it can not be read.
+    // makes no GL calls and does not touch the registry, so it can run on any thread.
+    static uint64_t HashFile(const std::string &path, size_t &fileBytes)
+    {
+        fileBytes = 0;
+        AssetData file;
+        if (!file.Open(path))
+            return 0;
+        fileBytes = file.Size();
+        return HashBytes(file.Data(), file.Size());
+    }
+
+    // the same for the faces of a cubemap, fileBytes is 0 when any face can not be read
+    static uint64_t HashFaces(const std::vector<std::string> &faces, size_t &fileBytes)
+    {
+        uint64_t content = 0;
+        fileBytes = 0;
+        for (const std::string &face : faces)
+        {
+            size_t faceBytes;
+            uint64_t faceContent = HashFile(face, faceBytes);
+            if (faceBytes == 0)
+            {
+                fileBytes = 0;
+                return 0;
+            }
+            content = HashBytes(&faceContent, sizeof(faceContent), content);
+            fileBytes += faceBytes;
+        }
+        return content;
+    }
+
+    // content and fileBytes are HashFile() of the path, fileBytes 0 when the caller did not hash it
+    unsigned int Acquire2D(const std::string &path, uint64_t content = 0, size_t fileBytes = 0)
+    {
+        std::string key = canonicalPath(path);
+        unsigned int id;
+        if (findByPath(key, id))
+            return id;
+
+        if (fileBytes == 0)
+            content = HashFile(path, fileBytes);
+        // an unreadable file is left to the loader to report, but a texture that has no content is not shared
+        if (fileBytes > 0 && findByContent(key, content, fileBytes, id))
+            return id;
+        return insert(key, content, fileBytes, TextureLoader::Instance().Load2D(path));
+    }
+
+    // faces in the GL order: +X, -X, +Y, -Y, +Z, -Z
+    // content and fileBytes are HashFaces() of the faces, fileBytes 0 when the caller did not hash them
+    unsigned int AcquireCubemap(const std::vector<std::string> &faces, uint64_t content = 0, size_t fileBytes = 0)
+    {
+        std::string key = "cubemap:";
+        for (const std::string &face : faces)
+            key += canonicalPath(face) + '|';
+        unsigned int id;
+        if (findByPath(key, id))
+            return id;
+
+        if (fileBytes == 0)
+            content = HashFaces(faces, fileBytes);
+        if (fileBytes > 0 && findByContent(key, content, fileBytes, id))
+            return id;
+        return insert(key, content, fileBytes, TextureLoader::Instance().LoadCubemap(faces));
+    }
+
+    // drops one reference, the GL texture is deleted with the last one
+    void Release(unsigned int id)
+    {
+        auto it = entries.find(id);
+        if (it == entries.end())
+            return;
+        if (--it->second.refCount > 0)
+            return;
+        for (const std::string &key : it->second.keys)
+            byPath.erase(key);
+        if (it->second.fileBytes > 0)
+            byContent.erase(contentKey(it->second.content, it->second.fileBytes));
+        GLState::Instance().DeleteTexture(id);
+        entries.erase(it);
+    }
+
+    // prints how often a texture was found instead of loaded and how much decoding/upload that avoided.
+    // upload sizes are only known once the loader finished, so call this after TextureLoader::Finish().
+    void PrintStats() const
+    {
+        size_t bytesSaved = 0;
+        for (const auto &entry : entries)
+            bytesSaved += entry.second.duplicateHits * entry.second.texture->bytes;
+        std::cout << "TEXTURE::REGISTRY:: " << entries.size() << " unique textures, " << pathHits << " path hits, "
+                  << contentHits << " content hits (same image under another path), "
+                  << bytesSaved / (1024.0 * 1024.0) << " MB of decode/upload saved" << std::endl;
+    }
+
+private:
+    struct Entry
+    {
+        TextureHandle texture;
+        int refCount;
+        unsigned int duplicateHits;         // acquisitions that did not load anything
+        uint64_t content;
+        size_t fileBytes;
+        std::vector<std::string> keys;      // every canonical path that resolved to this texture
+    };
+
+    std::unordered_map<unsigned int, Entry> entries;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<std::string, unsigned int> byContent;
+    unsigned int pathHits = 0;
+    unsigned int contentHits = 0;
+
+    static std::string canonicalPath(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+        return path;
+    }
+
+    // the file size is part of the key to make a 64-bit hash collision between different images even less likely
+    static std::string contentKey(uint64_t content, size_t fileBytes)
+    {
+        return std::to_string(content) + ':' + std::to_string(fileBytes);
+    }
+
+    bool findByPath(const std::string &key, unsigned int &id)
+    {
+        auto it = byPath.find(key);
+        if (it == byPath.end())
+            return false;
+        id = it->second;
+        Entry &entry = entries[id];
+        entry.refCount++;
+        entry.duplicateHits++;
+        pathHits++;
+        return true;
+    }
+
+    bool findByContent(const std::string &key, uint64_t content, size_t fileBytes, unsigned int &id)
+    {
+        auto it = byContent.find(contentKey(content, fileBytes));
+        if (it == byContent.end())
+            return false;
+        id = it->second;
+        Entry &entry = entries[id];
+        entry.refCount++;
+        entry.duplicateHits++;
+        entry.keys.push_back(key);
+        byPath[key] = id;   // the next request for this path is a plain path hit
+        contentHits++;
+        return true;
+    }
+
+    unsigned int insert(const std::string &key, uint64_t content, size_t fileBytes, TextureHandle texture)
+    {
+        Entry entry;
+        entry.texture = texture;
+        entry.refCount = 1;
+        entry.duplicateHits = 0;
+        entry.content = content;
+        entry.fileBytes = fileBytes;
+        entry.keys.push_back(key);
+        unsigned int id = texture->id;
+        byPath[key] = id;
+        if (fileBytes > 0)
+            byContent[contentKey(content, fileBytes)] = id;
+        entries[id] = entry;
+        return id;
+    }
+};
+
+#endif
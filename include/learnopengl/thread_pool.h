@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed-size pool of worker threads executing jobs in submission order.
+// jobs must not touch OpenGL: the context is only current on the thread that created the window.
+class ThreadPool
+{
+public:
+    // threadCount == 0 picks one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // queues a job and returns a future for its result. Exceptions thrown by the job are rethrown from future::get().
+    template<typename F>
+    auto Submit(F job) -> std::future<decltype(job())>
+    {
+        typedef decltype(job()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace_back([task] { (*task)(); });
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+    unsigned int ThreadCount() const { return (unsigned int)workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !jobs.empty(); });
+                // drain the remaining jobs before shutting down so no future is left without a value
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+#endif
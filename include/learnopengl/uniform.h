@@ -0,0 +1,144 @@
+#ifndef UNIFORM_H
+#define UNIFORM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// locations of the active uniforms of a linked program, by the names glGetUniformLocation accepts.
+// arrays are listed as "name", "name[0]" ... "name[n-1]"; uniforms in blocks have no location and are left out.
+inline std::unordered_map<std::string, GLint> ReflectUniforms(GLuint program)
+{
+    std::unordered_map<std::string, GLint> locations;
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> buffer((size_t)maxLength + 1);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), (size_t)length);
+        GLint location = glGetUniformLocation(program, name.c_str());
+        if (location < 0)
+            continue;
+        locations[name] = location;
+        // arrays are reported once, as "name[0]"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            std::string base = name.substr(0, name.size() - 3);
+            locations[base] = location;
+            for (GLint element = 1; element < size; element++)
+            {
+                std::string elementName = base + '[' + std::to_string(element) + ']';
+                locations[elementName] = glGetUniformLocation(program, elementName.c_str());
+            }
+        }
+    }
+    return locations;
+}
+
+inline void SetUniform(GLint location, bool value) { glUniform1i(location, (int)value); }
+inline void SetUniform(GLint location, int value) { glUniform1i(location, value); }
+inline void SetUniform(GLint location, float value) { glUniform1f(location, value); }
+inline void SetUniform(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+inline void SetUniform(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+inline void SetUniform(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+inline void SetUniform(GLint location, const glm::mat2 &value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniform(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniform(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+// the matrix that transforms normals like model transforms positions, the inverse transpose of its upper 3x3. When model
+// only rotates and scales uniformly that is the upper 3x3 itself up to a scale factor, which the shaders normalize away,
+// so the inverse is skipped.
+inline glm::mat3 NormalMatrix(const glm::mat4 &model)
+{
+    glm::mat3 m(model);
+    float xx = glm::dot(m[0], m[0]), yy = glm::dot(m[1], m[1]), zz = glm::dot(m[2], m[2]);
+    float tolerance = 1e-4f * std::max(xx, std::max(yy, zz));
+    bool uniformScale = std::abs(xx - yy) <= tolerance && std::abs(xx - zz) <= tolerance && std::abs(glm::dot(m[0], m[1])) <= tolerance &&
+                        std::abs(glm::dot(m[0], m[2])) <= tolerance && std::abs(glm::dot(m[1], m[2])) <= tolerance;
+    return uniformScale ? m : glm::transpose(glm::inverse(m));
+}
+
+// a uniform resolved once, Set() is a single glUniform call on the current program. Get one from Shader::Uniform<T>().
+// a uniform the program does not use (or the compiler optimized away) has location -1, setting it is a no-op like in GL.
+template <typename T>
+class UniformHandle
+{
+public:
+    UniformHandle() = default;
+    explicit UniformHandle(GLint location) : location(location) {}
+
+    void Set(const T &value) const { SetUniform(location, value); }
+
+    GLint Location() const { return location; }
+    bool Valid() const { return location >= 0; }
+
+private:
+    GLint location = -1;
+};
+
+// binding points of the uniform blocks shared by all programs. GL 3.3 has no layout(binding = N), so every program
+// points its blocks at them by name when it is linked (BindUniformBlocks); a block name missing here stays unbound.
+const GLuint FRAME_DATA_BINDING = 0;
+const GLuint LIGHTS_BINDING = 1;
+
+inline void BindUniformBlocks(GLuint program)
+{
+    static const std::pair<const char *, GLuint> blocks[] = {{"FrameData", FRAME_DATA_BINDING}, {"Lights", LIGHTS_BINDING}};
+    for (const auto &block : blocks)
+    {
+        GLuint index = glGetUniformBlockIndex(program, block.first);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, block.second);
+    }
+}
+
+// a uniform buffer holding one T, bound to a shared binding point. T has to match the std140 layout of the block.
+// Update() orphans the storage and writes the new contents in the same call, so the driver hands out fresh memory
+// instead of waiting for draws of the previous frame that still read the old contents.
+template <typename T>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(GLuint binding) : binding(binding)
+    {
+        glGenBuffers(1, &id);
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_STREAM_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+    }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    // deletes the buffer, call while the GL context is still current
+    void Release()
+    {
+        glDeleteBuffers(1, &id);
+        id = 0;
+    }
+
+    void Update(const T &data)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), &data, GL_STREAM_DRAW);
+    }
+
+    GLuint Binding() const { return binding; }
+
+private:
+    GLuint id = 0;
+    GLuint binding;
+};
+
+#endif
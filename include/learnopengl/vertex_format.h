@@ -0,0 +1,170 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// GPU-side vertex layouts a mesh can be uploaded in. The CPU side always works with the full-float Vertex above,
+// the packed layouts are produced right before the upload and the attribute setup follows the format.
+// the attribute locations stay the same in every layout (0 position, 1 normal, 2 uv, 3 tangent), so the shaders do not change.
+enum class VertexFormat {
+    Full,           // 56 bytes: float position, normal, uv, tangent, bitangent
+    Packed,         // 24 bytes: float position, 10:10:10:2 normal, half-float uv, 10:10:10:2 tangent with the bitangent sign in w
+    PositionOnly    // 12 bytes: float position, for depth-only and picking passes
+};
+
+inline const char *VertexFormatName(VertexFormat format)
+{
+    switch (format)
+    {
+        case VertexFormat::Packed: return "packed";
+        case VertexFormat::PositionOnly: return "position-only";
+        default: return "full";
+    }
+}
+
+struct PackedVertex {
+    glm::vec3 Position;
+    uint32_t  Normal;       // GL_INT_2_10_10_10_REV, normalized, w unused
+    uint16_t  TexCoords[2]; // GL_HALF_FLOAT, half floats keep tiling coordinates outside [0, 1]
+    uint32_t  Tangent;      // GL_INT_2_10_10_10_REV, normalized, w = +-1 is the sign of the bitangent: B = cross(N, T) * sign(w)
+};
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must stay tightly packed");
+
+// IEEE 754 binary16, rounded to nearest even. Values beyond the half range become infinity.
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponentBits = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+    if (exponentBits == 0xffu)
+        return (uint16_t)(sign | 0x7c00u | (mantissa ? 0x200u : 0u));   // infinity or NaN
+    int exponent = (int)exponentBits - 127 + 15;
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7c00u);
+    if (exponent <= 0)
+    {
+        // subnormal half, or zero when even that is too small
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        half++;     // a carry into the exponent is still the correctly rounded value
+    return (uint16_t)half;
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+            bits = sign;
+        else
+        {
+            // normalize the subnormal
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400u))
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+    }
+    else if (exponent == 31)
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// signed normalized 10:10:10:2 as read by GL_INT_2_10_10_10_REV with normalized = GL_TRUE.
+// The GL 3.3 conversion (2c + 1) / (2^b - 1) has no exact zero and maps the 2-bit -1 to -1/3, so the shaders
+// normalize xyz and only look at the sign of w.
+inline uint32_t PackSnorm1010102(const glm::vec3 &v, float w)
+{
+    auto component = [](float f, int bits) {
+        int maximum = (1 << (bits - 1)) - 1;
+        if (f != f)     // NaN from a degenerate normal
+            f = 0.0f;
+        float clamped = std::max(-1.0f, std::min(1.0f, f));
+        int value = (int)std::lround(clamped * maximum);
+        return (uint32_t)value & ((1u << bits) - 1u);
+    };
+    return component(v.x, 10) | component(v.y, 10) << 10 | component(v.z, 10) << 20 | component(w, 2) << 30;
+}
+
+// bytes per vertex in the GPU buffer
+inline size_t VertexStride(VertexFormat format)
+{
+    switch (format)
+    {
+        case VertexFormat::Packed: return sizeof(PackedVertex);
+        case VertexFormat::PositionOnly: return sizeof(glm::vec3);
+        default: return sizeof(Vertex);
+    }
+}
+
+// converts full-float vertices into the packed GPU layout
+inline std::vector<PackedVertex> PackVertices(const Vertex *vertices, size_t count)
+{
+    std::vector<PackedVertex> packed(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vertex &vertex = vertices[i];
+        PackedVertex &out = packed[i];
+        out.Position = vertex.Position;
+        out.Normal = PackSnorm1010102(vertex.Normal, 0.0f);
+        out.TexCoords[0] = FloatToHalf(vertex.TexCoords.x);
+        out.TexCoords[1] = FloatToHalf(vertex.TexCoords.y);
+        float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+        out.Tangent = PackSnorm1010102(vertex.Tangent, handedness);
+    }
+    return packed;
+}
+
+inline std::vector<glm::vec3> ExtractPositions(const Vertex *vertices, size_t count)
+{
+    std::vector<glm::vec3> positions(count);
+    for (size_t i = 0; i < count; i++)
+        positions[i] = vertices[i].Position;
+    return positions;
+}
+
+#endif
@@ -13,126 +13,193 @@
 #include <rg/Error.h>
 #include <common.h>
 #include <glm/glm.hpp>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/uniform.h>
+#include <chrono>
 class Shader {
     unsigned int m_Id;
+    // compile/link state kept until the first use(), status is not queried before that
+    int m_VertexShader = 0, m_FragmentShader = 0;
+    bool m_FromBinary = false;
+    bool m_Finished = false;
+    std::string m_ProgramName;
+    uint64_t m_ProgramKey = 0;
+    std::chrono::steady_clock::time_point m_SetupStart;
+    std::unordered_map<std::string, GLint> m_UniformLocations;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
         appendShaderFolderIfNotPresent(fragmentShaderPath);
-        // build and compile our shader program
-        // ------------------------------------
-        // vertex shader
+        m_SetupStart = std::chrono::steady_clock::now();
         std::string vsString = readFileContents(vertexShaderPath);
         ASSERT(!vsString.empty(), "Vertex shader source is empty!");
-        const char* vertexShaderSource = vsString.c_str();
-        int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-        glCompileShader(vertexShader);
-        // check for shader compile errors
-        int success;
-        char infoLog[512];
-        glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-        if (!success)
-        {
-            glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-        }
-        // fragment shader
-        int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
         std::string fsString = readFileContents(fragmentShaderPath);
         ASSERT(!fsString.empty(), "Fragment shader empty!");
-        const char* fragmentShaderSource = fsString.c_str();
-        glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-        glCompileShader(fragmentShader);
-        // check for shader compile errors
-        glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-        if (!success)
-        {
-            glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-        }
-        // link shaders
-        int shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-        // check for linking errors
-        glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        m_ProgramName = vertexShaderPath + '|' + fragmentShaderPath;
+        m_ProgramKey = ProgramCache::Key({&vsString, &fsString}, std::string());
+        int shaderProgram = ProgramCache::Load(m_ProgramName, m_ProgramKey);
+        m_FromBinary = shaderProgram != 0;
+        if (!m_FromBinary) {
+            // build and compile our shader program, errors are checked in finish()
+            // ------------------------------------
+            // vertex shader
+            const char* vertexShaderSource = vsString.c_str();
+            m_VertexShader = glCreateShader(GL_VERTEX_SHADER);
+            glShaderSource(m_VertexShader, 1, &vertexShaderSource, NULL);
+            glCompileShader(m_VertexShader);
+            // fragment shader
+            m_FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+            const char* fragmentShaderSource = fsString.c_str();
+            glShaderSource(m_FragmentShader, 1, &fragmentShaderSource, NULL);
+            glCompileShader(m_FragmentShader);
+            // link shaders
+            shaderProgram = glCreateProgram();
+            glAttachShader(shaderProgram, m_VertexShader);
+            glAttachShader(shaderProgram, m_FragmentShader);
+            ProgramCache::PrepareLink(shaderProgram);
+            glLinkProgram(shaderProgram);
         }
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
     }
 
+    // non-blocking, only meaningful with KHR/ARB_parallel_shader_compile; without it the program is reported ready
+    bool ready() const {
+        if (m_Finished || !GLExtensions().parallelShaderCompile)
+            return true;
+        int complete = GL_FALSE;
+        glGetProgramiv(m_Id, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+
+    // waits for the link and checks for errors, use() calls it the first time
+    void finish() {
+        if (m_Finished)
+            return;
+        m_Finished = true;
+        if (!m_FromBinary) {
+            int success;
+            char infoLog[512];
+            // check for linking errors, the compile logs only matter when linking failed
+            glGetProgramiv(m_Id, GL_LINK_STATUS, &success);
+            if (!success) {
+                glGetShaderiv(m_VertexShader, GL_COMPILE_STATUS, &success);
+                if (!success)
+                {
+                    glGetShaderInfoLog(m_VertexShader, 512, NULL, infoLog);
+                    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+                }
+                glGetShaderiv(m_FragmentShader, GL_COMPILE_STATUS, &success);
+                if (!success)
+                {
+                    glGetShaderInfoLog(m_FragmentShader, 512, NULL, infoLog);
+                    std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+                }
+                glGetProgramInfoLog(m_Id, 512, NULL, infoLog);
+                std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            } else {
+                ProgramCache::Store(m_Id, m_ProgramName, m_ProgramKey);
+            }
+            glDeleteShader(m_VertexShader);
+            glDeleteShader(m_FragmentShader);
+            m_VertexShader = m_FragmentShader = 0;
+        }
+        m_UniformLocations = ReflectUniforms(m_Id);
+        BindUniformBlocks(m_Id);
+        double setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_SetupStart).count();
+        std::cout << "SHADER::LOAD:: " << m_ProgramName << ": ready after " << setupMs << " ms ("
+                  << (m_FromBinary ? "program binary" : "compiled from source") << ")" << std::endl;
+    }
+
+    // location of an active uniform from the table built in finish(), -1 for names the program does not use
+    GLint uniformLocation(const std::string &name) const {
+        if (!m_Finished)
+            return glGetUniformLocation(m_Id, name.c_str());
+        auto found = m_UniformLocations.find(name);
+        return found != m_UniformLocations.end() ? found->second : -1;
+    }
+
+    // resolves a uniform once, setting it through the handle needs no string work or driver lookup
+    template <typename T>
+    UniformHandle<T> uniform(const std::string &name) {
+        finish();
+        return UniformHandle<T>(uniformLocation(name));
+    }
+
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(m_Id);
+        if (!m_Finished)
+            finish();
+        GLState::Instance().UseProgram(m_Id);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        glUniform1i(uniformLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1i(uniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1f(uniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform2fv(uniformLocation(name), 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        glUniform2f(uniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform3fv(uniformLocation(name), 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        glUniform3f(uniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform4fv(uniformLocation(name), 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        glUniform4f(uniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     void deleteProgram() {
-        glDeleteProgram(m_Id);
+        if (m_VertexShader != 0) {
+            glDeleteShader(m_VertexShader);
+            glDeleteShader(m_FragmentShader);
+            m_VertexShader = m_FragmentShader = 0;
+        }
+        m_Finished = true;
+        GLState::Instance().DeleteProgram(m_Id);
         m_Id = 0;
     }
 
@@ -3,11 +3,15 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main(){
     TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // the skybox follows the camera, only the rotation of the view is used
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }
\ No newline at end of file
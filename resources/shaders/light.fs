@@ -8,6 +8,8 @@ struct Material {
     float shininess;
 };
 
+// the light structs are laid out for std140: every vec3 starts a 16 byte slot and a float fills its last 4 bytes.
+// they mirror DirLightBlock, PointLightBlock and SpotLightBlock in main.cpp, keep the two in sync
 struct DirLight {
     vec3 direction;
 
@@ -18,29 +20,27 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
+    float constant;
 
-    vec3 specular;
-    vec3 diffuse;
     vec3 ambient;
-
-    float constant;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
 
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff;
     vec3 specular;
+    float outerCutOff;
 };
 
 in vec2 TexCoords;
@@ -48,11 +48,19 @@ in vec3 Normal;
 in vec3 FragPos;
 
 uniform Material material;
-uniform PointLight pointLight;
-uniform DirLight dirLight;
-uniform SpotLight spotLight;
 
-uniform vec3 viewPosition;
+// written once per frame by main(), shared by every program through fixed binding points
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+    SpotLight spotLight;
+};
 
 uniform int transparency;
 
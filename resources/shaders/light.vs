@@ -7,14 +7,41 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
+#ifdef INSTANCED
+// per instance, see InstanceBuffer: the placement, how fast the instance spins around its local y axis and the
+// normal matrix of the placement
+layout (location = 5) in mat4 instanceModel;
+layout (location = 9) in float instanceSpin;
+layout (location = 10) in mat3 instanceNormalMatrix;
+
+uniform float time;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// computed once per draw on the CPU (NormalMatrix), the upper 3x3 of model when it only scales uniformly
+uniform mat3 normalMatrix;
+#endif
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
+#ifdef INSTANCED
+    float angle = instanceSpin * time;
+    float c = cos(angle);
+    float s = sin(angle);
+    mat3 spin = mat3(c, 0.0, -s,
+                     0.0, 1.0, 0.0,
+                     s, 0.0, c);
+    // the spin is a rotation, so it is its own normal matrix
+    mat4 model = instanceModel * mat4(spin);
+    mat3 normalMatrix = instanceNormalMatrix * spin;
+#endif
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
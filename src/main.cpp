@@ -11,8 +11,13 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_manager.h>
+#include <learnopengl/startup_trace.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_loader.h>
+#include <learnopengl/render_queue.h>
 
 #include <iostream>
 
@@ -23,6 +28,10 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+//size of the default framebuffer in pixels, kept up to date by framebuffer_size_callback (differs from the window size on HiDPI)
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
@@ -73,6 +82,9 @@ struct ProgramState {
     bool ImGuiEnabled = false;
     Camera camera;
     bool CameraMouseMovementUpdateEnabled = true;
+    bool MeshLodEnabled = true;
+    bool ClusterCullingEnabled = true;
+    bool StateCacheEnabled = true;
 
     Object island;
     Object spyro;
@@ -141,10 +153,114 @@ unsigned int loadCubemap(vector<std::string> faces);
 
 ProgramState *programState;
 
+//per frame averages of the rendering counters, separately for every combination of mesh LOD, cluster culling and
+//the GL state cache, so switching them in the ImGui window compares them on the same scene
+struct FrameStats {
+    static const int MODES = 8;
+    unsigned long long triangles[MODES] = {};
+    unsigned long long drawCalls[MODES] = {};
+    unsigned long long clustersCulled[MODES] = {};
+    unsigned long long stateIssued[MODES] = {};
+    unsigned long long stateElided[MODES] = {};
+    unsigned long long frames[MODES] = {};
+    RenderStats last;
+    GLStateStats lastState;
+
+    void Add(int mode) {
+        triangles[mode] += last.triangles;
+        drawCalls[mode] += last.drawCalls;
+        clustersCulled[mode] += last.clustersCulled;
+        stateIssued[mode] += lastState.issued;
+        stateElided[mode] += lastState.elided;
+        frames[mode]++;
+    }
+
+    void Print() const {
+        for (int mode = 0; mode < MODES; mode++) {
+            if (frames[mode] == 0)
+                continue;
+            std::cout << "RENDER:: mesh LOD " << (mode & 1 ? "on" : "off") << ", cluster culling " << (mode & 2 ? "on" : "off")
+                      << ", state cache " << (mode & 4 ? "on" : "off") << ": "
+                      << triangles[mode] / frames[mode] << " triangles, " << drawCalls[mode] / frames[mode] << " draw calls, "
+                      << clustersCulled[mode] / frames[mode] << " clusters culled, " << stateIssued[mode] / frames[mode]
+                      << " state calls issued / " << stateElided[mode] / frames[mode] << " elided per frame ("
+                      << frames[mode] << " frames)" << std::endl;
+        }
+    }
+};
+FrameStats frameStats;
+
+//std140 mirrors of the uniform blocks in light.fs/light.vs/cubemap.vs: every vec3 starts a 16 byte slot, a float
+//may fill its last 4 bytes, vec3s without one are padded. Written once per frame, read by every program.
+struct FrameBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float padding;
+};
+
+struct DirLightBlock {
+    glm::vec3 direction; float padding0;
+    glm::vec3 ambient; float padding1;
+    glm::vec3 diffuse; float padding2;
+    glm::vec3 specular; float padding3;
+};
+
+struct PointLightBlock {
+    glm::vec3 position; float constant;
+    glm::vec3 ambient; float linear;
+    glm::vec3 diffuse; float quadratic;
+    glm::vec3 specular; float padding;
+};
+
+struct SpotLightBlock {
+    glm::vec3 position; float constant;
+    glm::vec3 direction; float linear;
+    glm::vec3 ambient; float quadratic;
+    glm::vec3 diffuse; float cutOff;
+    glm::vec3 specular; float outerCutOff;
+};
+
+struct LightsBlock {
+    DirLightBlock dirLight;
+    PointLightBlock pointLight;
+    SpotLightBlock spotLight;
+};
+static_assert(sizeof(FrameBlock) == 144, "FrameBlock must match the std140 layout of FrameData");
+static_assert(sizeof(LightsBlock) == 208, "LightsBlock must match the std140 layout of Lights");
+
+//uniforms the render loop sets itself, resolved once so setting them is a single glUniform call;
+//model and transparency are set per draw by the render queue
+struct SceneUniforms {
+    UniformHandle<float> shininess;
+    UniformHandle<int> textureDiffuse1, textureSpecular1;
+
+    void Resolve(Shader &shader) {
+        shininess = shader.Uniform<float>("material.shininess");
+        textureDiffuse1 = shader.Uniform<int>("material.texture_diffuse1");
+        textureSpecular1 = shader.Uniform<int>("material.texture_specular1");
+    }
+};
+
 void DrawImGui(ProgramState *programState);
 
 int main() {
-    glfwInit();
+    //STARTUP TRACE: every phase until the first frame with all assets, written to startup_report.json
+    //and startup_trace.json (chrome://tracing) at exit
+    StartupTrace::Instance();
+    double startupTime = 0.0;
+    {
+        TraceScope trace("startup", "glfwInit");
+        glfwInit();
+    }
+    startupTime = glfwGetTime();
+    //ASSETS: when resources.pack (built by asset_packer) exists, shaders, models and textures are read from it
+    {
+        TraceScope trace("startup", "open asset pack");
+        if (AssetPack::Instance().Open("resources.pack"))
+            std::cout << "ASSETS:: resources.pack: " << AssetPack::Instance().EntryCount() << " files, "
+                      << AssetPack::Instance().Size() / (1024.0 * 1024.0) << " MB mapped" << std::endl;
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -153,6 +269,7 @@ int main() {
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
+    TraceScope windowTrace("startup", "create window");
     GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -160,17 +277,22 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
+    windowTrace.End();
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    TraceScope gladTrace("startup", "gladLoadGLLoader");
     if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
+    gladTrace.End();
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -178,6 +300,7 @@ int main() {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
 
+    TraceScope imguiTrace("startup", "ImGui init");
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO &io = ImGui::GetIO();
@@ -185,25 +308,52 @@ int main() {
 
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
+    imguiTrace.End();
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    //RENDER STATE: all binds and switches of the renderer go through GLState, which skips the ones that change nothing
+    GLState &glState = GLState::Instance();
+    glState.SetEnabled(GL_DEPTH_TEST, true);
+    glState.SetEnabled(GL_BLEND, true);
+    glState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     //SHADERS::
-    Shader ourShader("resources/shaders/light.vs", "resources/shaders/light.fs");
-    Shader cubemapShader("resources/shaders/cubemap.vs", "resources/shaders/cubemap.fs");
+    //only submitted here, the driver compiles them while the models load; shaderManager.Poll() picks them up
+    TraceScope shadersTrace("startup", "shaders");
+    ShaderManager shaderManager;
+    Shader &ourShader = shaderManager.Add("resources/shaders/light.vs", "resources/shaders/light.fs");
+    Shader &cubemapShader = shaderManager.Add("resources/shaders/cubemap.vs", "resources/shaders/cubemap.fs");
+    //the same lighting for repeated models, transforms come from a per-instance attribute instead of the model uniform
+    Shader &instancedShader = shaderManager.Add("resources/shaders/light.vs", "resources/shaders/light.fs", nullptr, "#define INSTANCED\n");
+
+    shadersTrace.End();
 
     //MODELS:
+    TraceScope modelsTrace("startup", "queue models");
+    //imported in parallel on worker threads while the render loop already runs,
+    //each model is uploaded by modelLoader.Poll() as soon as its import finishes and draws as a box until then
+    Model islandModel, spyroModel, portalModel, keyModel, chestModel, diamondModel;
+    //nothing reads the vertices back on the CPU, so the geometry only lives in the GL buffers once uploaded,
+    //and there in the 24 byte packed layout (light.vs reads the normals and uvs through the same locations)
+    for (Model *model : {&islandModel, &spyroModel, &portalModel, &keyModel, &chestModel, &diamondModel}) {
+        model->geometryRetention = GeometryRetention::Release;
+        model->vertexFormat = VertexFormat::Packed;
+    }
+    ModelLoader modelLoader;
+    modelLoader.Load(islandModel, "resources/objects/island/island.obj");
+    modelLoader.Load(spyroModel, "resources/objects/spyro/spyro.obj");
+    modelLoader.Load(portalModel, "resources/objects/portal/portal.obj");
+    modelLoader.Load(keyModel, "resources/objects/old_key/old_key.obj");
+    modelLoader.Load(chestModel, "resources/objects/chest/chest.obj");
+    modelLoader.Load(diamondModel, "resources/objects/diamond/diamond.obj");
+    modelsTrace.End();
+
     //ISLAND:
-    Model islandModel("resources/objects/island/island.obj");
     islandModel.SetShaderTextureNamePrefix("material.");
     Object& islandObj = programState->island;
     islandObj.position = glm::vec3(12.0f, 0.0f, 1.0f);
     islandObj.scale = 0.2f;
 
     //SPYRO
-    Model spyroModel("resources/objects/spyro/spyro.obj");
     spyroModel.SetShaderTextureNamePrefix("material.");
     Object& spyroObj = programState->spyro;
     spyroObj.position = glm::vec3(15.498f, -1.85f, 5.23524f);
@@ -211,7 +361,6 @@ int main() {
     spyroObj.rotationY = -85.0f;
 
     //PORTAL:
-    Model portalModel("resources/objects/portal/portal.obj");
     portalModel.SetShaderTextureNamePrefix("material.");
     Object& portalObj = programState->portal;
     portalObj.position = glm::vec3 (17.13f, -1.94783f, 6.77324f);
@@ -219,7 +368,6 @@ int main() {
     portalObj.rotationY = 55.0f;
 
     //KEY:
-    Model keyModel("resources/objects/old_key/old_key.obj");
     keyModel.SetShaderTextureNamePrefix("material.");
     Object& keyObj = programState->key;
     keyObj.position = glm::vec3(8.97785f, -0.11684f, 1.30846f);
@@ -227,7 +375,6 @@ int main() {
     keyObj.rotationX = 55.0;
 
     //CHEST:
-    Model chestModel("resources/objects/chest/chest.obj");
     chestModel.SetShaderTextureNamePrefix("material.");
     Object& chestObj = programState->chest;
     chestObj.position = glm::vec3 (10.9758f, 0.222281f, -0.0916667f);
@@ -235,7 +382,6 @@ int main() {
     chestObj.rotationY = 150.0f;
 
     //DIAMONDS:
-    Model diamondModel("resources/objects/diamond/diamond.obj");
     diamondModel.SetShaderTextureNamePrefix("material.h");
     Object& diamondObj = programState->diamond;
     diamondObj.scale = 0.002f;
@@ -270,7 +416,7 @@ int main() {
     glGenBuffers(1, &portalVBO);
     glGenBuffers(1, &portalEBO);
 
-    glBindVertexArray(portalVAO);
+    glState.BindVertexArray(portalVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, portalVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(portalVertices), portalVertices, GL_STATIC_DRAW);
@@ -288,10 +434,12 @@ int main() {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8*sizeof(float), (void*)(6*sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    glBindVertexArray(0);
+    glState.BindVertexArray(0);
 
+    TraceScope texturesTrace("startup", "loadTexture x2");
     unsigned int diffuseMap = loadTexture("resources/textures/portal_textures/water.jpg");
     unsigned int specularMap = loadTexture("resources/textures/portal_textures/specular_map.jpg");
+    texturesTrace.End();
 
     Object& portalWaterObj = programState->portalWater;
     portalWaterObj.position = glm::vec3(17.2534f, -0.958174f, 6.71231f);
@@ -354,7 +502,7 @@ int main() {
     glGenVertexArrays(1, &cubemapVAO);
     glGenBuffers(1, &cubemapVBO);
 
-    glBindVertexArray(cubemapVAO);
+    glState.BindVertexArray(cubemapVAO);
     glBindBuffer(GL_ARRAY_BUFFER, cubemapVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubemapVertices), &cubemapVertices, GL_STATIC_DRAW);
 
@@ -362,9 +510,9 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
+    TraceScope cubemapTrace("startup", "loadCubemap");
     unsigned int cubemapTexture = loadCubemap(faces);
-    cubemapShader.use();
-    cubemapShader.setInt("cubemap", 0);
+    cubemapTrace.End();
 
     //LIGHTS:
     DirLight& dirLight = programState->dirLight;
@@ -395,163 +543,240 @@ int main() {
     spotLight.cutOff = 12.5f;
     spotLight.outerCutOff = 15.0f;
 
+    //UNIFORMS: the last setup step, so the shaders compiled in the background while everything above ran
+    SceneUniforms sceneUniforms;
+    sceneUniforms.Resolve(ourShader);
+    DrawUniforms drawUniforms;
+    drawUniforms.Resolve(ourShader);
+    UniformHandle<int> cubemapSampler = cubemapShader.Uniform<int>("cubemap");
+    SceneUniforms instancedUniforms;
+    instancedUniforms.Resolve(instancedShader);
+    DrawUniforms instancedDrawUniforms;
+    instancedDrawUniforms.Resolve(instancedShader);
+    UniformHandle<float> instanceTime = instancedShader.Uniform<float>("time");
+    //camera and lights, one buffer update each per frame instead of a glUniform call per value and program
+    UniformBuffer<FrameBlock> frameBuffer(FRAME_DATA_BINDING);
+    UniformBuffer<LightsBlock> lightsBuffer(LIGHTS_BINDING);
+
+    //RENDER STATES: what each kind of draw needs, the queue orders the draws and only changes what differs
+    DrawState opaqueState;
+    opaqueState.shader = &ourShader;
+    opaqueState.uniforms = &drawUniforms;
+    DrawState diamondState = opaqueState;
+    diamondState.pass = RenderPass::Transparent;
+    diamondState.transparency = 1;
+    DrawState portalWaterState = diamondState;
+    portalWaterState.transparency = 2;
+    portalWaterState.cullBackFaces = true;
+    portalWaterState.frontFace = GL_CW;
+    //all diamonds are one instanced draw per mesh
+    diamondState.shader = &instancedShader;
+    diamondState.uniforms = &instancedDrawUniforms;
+    DrawState skyboxState;
+    skyboxState.shader = &cubemapShader;
+    skyboxState.pass = RenderPass::Skybox;
+    //drawn at the far plane by cubemap.vs, so it only passes where nothing was drawn
+    skyboxState.depthWrite = false;
+    skyboxState.depthFunc = GL_LEQUAL;
+
+    RawDraw portalWater;
+    portalWater.vao = portalVAO;
+    portalWater.count = 6;
+    portalWater.indexed = true;
+    portalWater.textures[0] = {0, GL_TEXTURE_2D, diffuseMap, sceneUniforms.textureDiffuse1.Location()};
+    portalWater.textures[1] = {1, GL_TEXTURE_2D, specularMap, sceneUniforms.textureSpecular1.Location()};
+    portalWater.textureCount = 2;
+    RawDraw skybox;
+    skybox.vao = cubemapVAO;
+    skybox.count = 36;
+    skybox.textures[0] = {0, GL_TEXTURE_CUBE_MAP, cubemapTexture, cubemapSampler.Location()};
+    skybox.textureCount = 1;
+
+    RenderQueue renderQueue;
+    InstanceBuffer diamondInstances;
+    vector<InstanceData> diamondData(diamondNumber);
+
+    bool firstFrame = true;
+    bool assetsLoaded = false;
+
     while (!glfwWindowShouldClose(window)) {
+        //the uploads of the streamed assets nest in the frame that does them
+        TraceScope frameTrace("frame", "frame");
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        //STREAMING:
+        //upload what the workers finished since the last frame, the rest keeps drawing as proxies/fallbacks
+        modelLoader.Poll();
+        shaderManager.Poll();
+        TextureLoader::Instance().ProcessUploads();
+        if (!assetsLoaded && modelLoader.Done() && !TextureLoader::Instance().Busy()) {
+            assetsLoaded = true;
+            std::cout << "STARTUP:: all assets loaded after " << (glfwGetTime() - startupTime) * 1000.0 << " ms, resident "
+                      << BytesToMB(ResidentSetBytes()) << " MB" << std::endl;
+            TextureLoader::Instance().PrintStats();
+            TextureRegistry::Instance().PrintStats();
+            GeometryArena::PrintStats();
+        }
+
         processInput(window);
         processLamp(window, spotLight);
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        std::sort(diamondPositions.begin(), diamondPositions.end(),
-                  [cameraPosition = programState->camera.Position](const glm::vec3& a, const glm::vec3& b) {
-                      float d1 = glm::distance(a, cameraPosition);
-                      float d2 = glm::distance(b, cameraPosition);
-                      return d1 > d2;
-                  });
-
         ourShader.use();
 
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-        ourShader.setInt("transparency", 0);
+        sceneUniforms.shininess.Set(32.0f);
+        instancedShader.use();
+        instancedUniforms.shininess.Set(32.0f);
+        instanceTime.Set((float) glfwGetTime());
 
         //SET LIGHTS:
+        LightsBlock lights;
         //DIRECTIONAL LIGHT:
-        ourShader.setVec3("dirLight.direction", dirLight.direction);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-        ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        ourShader.setVec3("dirLight.specular", dirLight.specular);
+        lights.dirLight.direction = dirLight.direction;
+        lights.dirLight.ambient = dirLight.ambient;
+        lights.dirLight.diffuse = dirLight.diffuse;
+        lights.dirLight.specular = dirLight.specular;
 
         //POINTLIGHT:
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
+        lights.pointLight.position = pointLight.position;
+        lights.pointLight.ambient = pointLight.ambient;
+        lights.pointLight.diffuse = pointLight.diffuse;
+        lights.pointLight.specular = pointLight.specular;
 
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
+        lights.pointLight.constant = pointLight.constant;
+        lights.pointLight.linear = pointLight.linear;
+        lights.pointLight.quadratic = pointLight.quadratic;
 
         //SPOTLIGHT:
-        ourShader.setVec3("spotLight.position", programState->camera.Position);
-        ourShader.setVec3("spotLight.direction", programState->camera.Front);
+        lights.spotLight.position = programState->camera.Position;
+        lights.spotLight.direction = programState->camera.Front;
 
-        ourShader.setVec3("spotLight.ambient", spotLight.ambient);
-        ourShader.setVec3("spotLight.diffuse", spotLight.diffuse);
-        ourShader.setVec3("spotLight.specular", spotLight.specular);
+        lights.spotLight.ambient = spotLight.ambient;
+        lights.spotLight.diffuse = spotLight.diffuse;
+        lights.spotLight.specular = spotLight.specular;
 
-        ourShader.setFloat("spotLight.constant", spotLight.constant);
-        ourShader.setFloat("spotLight.linear", spotLight.linear);
-        ourShader.setFloat("spotLight.quadratic", spotLight.quadratic);
-        ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(spotLight.cutOff)));
-        ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(spotLight.outerCutOff)));
+        lights.spotLight.constant = spotLight.constant;
+        lights.spotLight.linear = spotLight.linear;
+        lights.spotLight.quadratic = spotLight.quadratic;
+        lights.spotLight.cutOff = glm::cos(glm::radians(spotLight.cutOff));
+        lights.spotLight.outerCutOff = glm::cos(glm::radians(spotLight.outerCutOff));
+        lightsBuffer.Update(lights);
 
         //TRANSFORMATIONS:
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),(float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        //RENDER ISLAND:
+        //meshes outside the view are skipped, far away ones are drawn at a coarser level of detail and large ones only
+        //submit their visible clusters; LOD and cluster culling can be switched off in the ImGui window
+        //the LOD error is measured in pixels of the framebuffer actually rendered to
+        RenderView renderView(programState->camera, (float) framebufferWidth / (float) framebufferHeight, 0.1f, 100.0f,
+                              (float) framebufferHeight);
+        renderView.meshLod = programState->MeshLodEnabled;
+        renderView.clusterCulling = programState->ClusterCullingEnabled;
+        glm::mat4 projection = renderView.projection;
+        glm::mat4 view = renderView.view;
+        FrameBlock frame;
+        frame.projection = projection;
+        frame.view = view;
+        frame.viewPosition = programState->camera.Position;
+        frameBuffer.Update(frame);
+
+        //SUBMIT: draws go into the queue in any order, it sorts them by pass and state (opaque front to back,
+        //transparent back to front, skybox last) and issues them in that order
+        renderQueue.Begin(renderView);
         glm::mat4 model = glm::mat4(1.0f);
         renderModel(model, islandObj);
-        ourShader.setMat4("model", model);
-        islandModel.Draw(ourShader);
+        islandModel.Submit(renderQueue, opaqueState, model, renderView);
 
-        //RENDER SPYRO:
         renderModel(model, spyroObj);
-        ourShader.setMat4("model", model);
-        spyroModel.Draw(ourShader);
+        spyroModel.Submit(renderQueue, opaqueState, model, renderView);
 
-        //RENDER PORTAL:
         renderModel(model, portalObj);
-        ourShader.setMat4("model", model);
-        portalModel.Draw(ourShader);
+        portalModel.Submit(renderQueue, opaqueState, model, renderView);
 
-        //RENDER KEY:
         renderModel(model, keyObj);
         model = glm::rotate(model, (float)glfwGetTime(), glm::vec3 (0.0f, 0.0f, 1.0f));
-        ourShader.setMat4("model", model);
-        keyModel.Draw(ourShader);
+        keyModel.Submit(renderQueue, opaqueState, model, renderView);
 
-        //RENDER CHEST:
         renderModel(model, chestObj);
-        ourShader.setMat4("model", model);
-        chestModel.Draw(ourShader);
+        chestModel.Submit(renderQueue, opaqueState, model, renderView);
 
-        //RENDER DIAMONDS:
-        ourShader.setInt("transparency", 1);
+        //the spin is computed in light.vs from the time uniform, the instances only carry their placement;
+        //they blend, so they go into the buffer back to front
+        glm::vec3 diamondCenter(0.0f);
         for(unsigned int i=0; i<diamondNumber; ++i) {
             diamondObj.position = diamondPositions[i];
-            renderModel(model, diamondObj);
-            model = glm::rotate(model, 2.0f * (float) glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
-            ourShader.setMat4("model", model);
-            diamondModel.Draw(ourShader);
+            renderModel(diamondData[i].model, diamondObj);
+            diamondData[i].spin = 2.0f;
+            diamondData[i].normalMatrix = NormalMatrix(diamondData[i].model);
+            diamondCenter += diamondPositions[i] / (float) diamondNumber;
         }
-        ourShader.setInt("transparency", 0);
-
-        //RENDER PORTAL WATER:
-        glEnable(GL_CULL_FACE);
-        glFrontFace(GL_CW);
-        glCullFace(GL_BACK);
+        std::sort(diamondData.begin(), diamondData.end(),
+                  [cameraPosition = programState->camera.Position](const InstanceData& a, const InstanceData& b) {
+                      return glm::distance(glm::vec3(a.model[3]), cameraPosition) > glm::distance(glm::vec3(b.model[3]), cameraPosition);
+                  });
+        diamondInstances.Update(diamondData);
+        diamondModel.SubmitInstanced(renderQueue, diamondState, diamondInstances, diamondCenter);
 
-        ourShader.setInt("transparency", 2);
         renderModel(model, portalWaterObj);
-        ourShader.setMat4("model", model);
-        ourShader.setInt("material.texture_diffuse1", 0);
-        ourShader.setInt("material.texture_specular1", 1);
-        ourShader.setFloat("material.shininess", 32);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, specularMap);
-        glBindVertexArray(portalVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        ourShader.setInt("transparency", 0);
-        glBindVertexArray(0);
-        glDisable(GL_CULL_FACE);
-
-        //CUBEMAP:
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
-        cubemapShader.use();
-        view = glm::mat4 (glm::mat3 (programState->camera.GetViewMatrix()));
-        cubemapShader.setMat4("view", view);
-        cubemapShader.setMat4("projection", projection);
-
-        glBindVertexArray(cubemapVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
-
-        if (programState->ImGuiEnabled)
+        renderQueue.SubmitRaw(portalWaterState, model, portalWater, portalWaterObj.position);
+
+        //projection and view come from FrameData, cubemap.vs drops the translation itself
+        renderQueue.SubmitRaw(skyboxState, glm::mat4(1.0f), skybox, programState->camera.Position);
+
+        renderQueue.Execute();
+
+        if (programState->ImGuiEnabled) {
             DrawImGui(programState);
+            //ImGui sets its own state and restores it directly, so the shadow copy can no longer be trusted
+            glState.Invalidate();
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrame) {
+            firstFrame = false;
+            std::cout << "STARTUP:: first frame after " << (glfwGetTime() - startupTime) * 1000.0 << " ms" << std::endl;
+        }
+        frameTrace.End();
+        if (assetsLoaded)
+            StartupTrace::Instance().Stop();
+        frameStats.last = RenderStats::Frame();
+        RenderStats::Frame() = RenderStats();
+        frameStats.lastState = glState.Stats();
+        glState.Stats() = GLStateStats();
+        if (assetsLoaded) {
+            frameStats.Add((programState->MeshLodEnabled ? 1 : 0) | (programState->ClusterCullingEnabled ? 2 : 0) |
+                           (programState->StateCacheEnabled ? 4 : 0));
+        }
+        glState.elide = programState->StateCacheEnabled;
     }
+    frameStats.Print();
+    if (StartupTrace::Instance().WriteReport("startup_report.json") && StartupTrace::Instance().WriteChromeTrace("startup_trace.json"))
+        std::cout << "STARTUP:: trace written to startup_report.json and startup_trace.json" << std::endl;
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
-    glDeleteVertexArrays(1, &portalVAO);
-    glDeleteVertexArrays(1, &cubemapVAO);
+    glState.DeleteVertexArray(portalVAO);
+    glState.DeleteVertexArray(cubemapVAO);
     glDeleteBuffers(1, &portalVBO);
     glDeleteBuffers(1, &cubemapVBO);
     glDeleteBuffers(1, &portalEBO);
-    glDeleteShader(ourShader.ID);
-    glDeleteShader(cubemapShader.ID);
-    glDeleteTextures(1, &diffuseMap);
-    glDeleteTextures(1, &specularMap);
-    glDeleteTextures(1, &cubemapTexture);
+    frameBuffer.Release();
+    lightsBuffer.Release();
+    diamondInstances.Release();
+    glState.DeleteProgram(ourShader.ID);
+    glState.DeleteProgram(cubemapShader.ID);
+    glState.DeleteProgram(instancedShader.ID);
+    TextureRegistry::Instance().Release(diffuseMap);
+    TextureRegistry::Instance().Release(specularMap);
+    TextureRegistry::Instance().Release(cubemapTexture);
+    //no worker may still import into a model while it is released, and the arenas go last, after every mesh gave its range back
+    modelLoader.Finish();
+    for (Model *model : {&islandModel, &spyroModel, &portalModel, &keyModel, &chestModel, &diamondModel})
+        model->Release();
+    GeometryArena::ReleaseAll();
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -590,6 +815,11 @@ void processLamp(GLFWwindow *window, SpotLight& spotLight){
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     glViewport(0, 0, width, height);
+    //a minimized window reports 0x0, keep the last size so the projection stays valid
+    if (width > 0 && height > 0) {
+        framebufferWidth = width;
+        framebufferHeight = height;
+    }
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
@@ -641,6 +871,19 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Rendering");
+        ImGui::Checkbox("Mesh LOD", &programState->MeshLodEnabled);
+        ImGui::Text("Triangles: %llu", frameStats.last.triangles);
+        ImGui::Text("Draw calls: %u", frameStats.last.drawCalls);
+        ImGui::Checkbox("Cluster culling", &programState->ClusterCullingEnabled);
+        ImGui::Text("Meshes culled: %u", frameStats.last.meshesCulled);
+        ImGui::Text("Clusters drawn / culled: %u / %u", frameStats.last.clustersDrawn, frameStats.last.clustersCulled);
+        ImGui::Checkbox("GL state cache", &programState->StateCacheEnabled);
+        ImGui::Text("State calls issued / elided: %llu / %llu", frameStats.lastState.issued, frameStats.lastState.elided);
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -673,61 +916,9 @@ void renderModel(glm::mat4& model, Object& object){
 }
 
 unsigned int loadTexture(char const * path){
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data){
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else{
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-    return textureID;
+    return TextureRegistry::Instance().Acquire2D(path);
 }
 
 unsigned int loadCubemap(vector<std::string> faces){
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for(unsigned int i=0; i<faces.size(); i++){
-
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if(data){
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else{
-            std::cout << "Cubemap failed to load at path: " << faces[i] << '\n';
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return TextureRegistry::Instance().AcquireCubemap(faces);
 }
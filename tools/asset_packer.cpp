@@ -0,0 +1,76 @@
+// builds the single-file asset pack read through AssetData (asset_pack.h). Directories are packed recursively,
+// entries are stored under the paths as given, so run it from the directory the application runs in.
+// mesh caches and previous packs are skipped, they are written at runtime next to their sources.
+//
+// usage: asset_packer [--compress] [output.pack] [file or directory...]
+//   without arguments: resources.pack from resources/, run it from the repository root
+
+#include <learnopengl/asset_pack.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static bool endsWith(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void collect(const std::string &path, std::vector<std::string> &files)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        std::fprintf(stderr, "asset_packer: cannot read %s\n", path.c_str());
+        return;
+    }
+    if (!S_ISDIR(st.st_mode))
+    {
+        if (!endsWith(path, ".meshcache") && !endsWith(path, ".pack") && !endsWith(path, ".tmp"))
+            files.push_back(path);
+        return;
+    }
+    DIR *dir = opendir(path.c_str());
+    if (!dir)
+        return;
+    while (dirent *entry = readdir(dir))
+    {
+        if (std::strcmp(entry->d_name, ".") != 0 && std::strcmp(entry->d_name, "..") != 0)
+            collect(path + '/' + entry->d_name, files);
+    }
+    closedir(dir);
+}
+
+int main(int argc, char **argv)
+{
+    bool compress = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--compress") == 0)
+            compress = true;
+        else
+            args.push_back(argv[i]);
+    }
+    std::string packPath = args.empty() ? "resources.pack" : args[0];
+    std::vector<std::string> roots(args.size() > 1 ? args.begin() + 1 : args.end(), args.end());
+    if (roots.empty())
+        roots.push_back("resources");
+
+    std::vector<std::string> files;
+    for (const std::string &root : roots)
+        collect(root, files);
+    AssetPackStats stats;
+    if (files.empty() || !WriteAssetPack(packPath, files, compress, stats))
+    {
+        std::fprintf(stderr, "asset_packer: could not write %s\n", packPath.c_str());
+        return 1;
+    }
+    std::printf("%s: %zu files (%zu compressed), %.1f MB -> %.1f MB\n", packPath.c_str(), stats.files, stats.compressed,
+                stats.sourceBytes / (1024.0 * 1024.0), stats.packBytes / (1024.0 * 1024.0));
+    return 0;
+}
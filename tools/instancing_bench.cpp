@@ -0,0 +1,166 @@
+// instancing benchmark: frame time of drawing N spinning diamonds, for N from 10 to 100000, two ways:
+//   draws     - what main() did before instancing: per diamond the model matrix with its rotation, the per-draw
+//               uniforms and Model's draw of every mesh
+//   instanced - the placements written to an InstanceBuffer, one glDrawElementsInstanced per mesh with light.vs
+//               compiled with INSTANCED, which spins the diamonds from the time uniform
+// a frame is timed until glFinish returns, so it is CPU submission and GPU work together. Runs on a hidden window.
+//
+// usage: instancing_bench [frames]
+//   run it from the repository root
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/uniform.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const unsigned int WIDTH = 1280;
+static const unsigned int HEIGHT = 720;
+static const unsigned int COUNTS[] = {10, 100, 1000, 10000, 100000};
+
+struct FrameBlock { glm::mat4 projection, view; glm::vec4 viewPosition; };
+struct LightsBlock { glm::vec4 slots[13]; };
+
+// the diamonds on a square grid around the origin, scaled like in main()
+static std::vector<glm::vec3> gridPositions(unsigned int count, float spacing)
+{
+    std::vector<glm::vec3> positions;
+    unsigned int side = (unsigned int)std::ceil(std::sqrt((double)count));
+    for (unsigned int i = 0; i < count; i++)
+        positions.push_back(glm::vec3(((float)(i % side) - side * 0.5f) * spacing, 0.0f, ((float)(i / side) - side * 0.5f) * spacing));
+    return positions;
+}
+
+template<typename F>
+static double millisPerFrame(int frames, F frame)
+{
+    frame(0);
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        frame(i);
+        glFinish();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 30;
+    if (!glfwInit())
+        return 1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "instancing_bench", NULL, NULL);
+    if (!window)
+    {
+        std::printf("could not create a GL 3.3 context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+        return 1;
+    LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
+
+    {
+        Shader shader("resources/shaders/light.vs", "resources/shaders/light.fs");
+        Shader instancedShader("resources/shaders/light.vs", "resources/shaders/light.fs", nullptr, "#define INSTANCED\n");
+        Model diamond("resources/objects/diamond/diamond.obj");
+        diamond.SetShaderTextureNamePrefix("material.h");
+        TextureLoader::Instance().Finish();
+        const float scale = 0.002f;
+        const float spacing = 0.1f;
+
+        UniformBuffer<FrameBlock> frameBuffer(FRAME_DATA_BINDING);
+        UniformBuffer<LightsBlock> lightsBuffer(LIGHTS_BINDING);
+        LightsBlock lights;
+        for (glm::vec4 &slot : lights.slots)
+            slot = glm::vec4(0.3f, -1.0f, 0.3f, 1.0f);
+        lightsBuffer.Update(lights);
+
+        UniformHandle<glm::mat4> model = shader.Uniform<glm::mat4>("model");
+        UniformHandle<glm::mat3> normalMatrix = shader.Uniform<glm::mat3>("normalMatrix");
+        UniformHandle<float> time = instancedShader.Uniform<float>("time");
+        InstanceBuffer instances;
+        std::vector<InstanceData> instanceData;
+
+        glViewport(0, 0, WIDTH, HEIGHT);
+        glEnable(GL_DEPTH_TEST);
+        std::printf("%d frames per count, ms per frame until glFinish\n", frames);
+        std::printf("%10s %12s %12s %9s\n", "diamonds", "draws", "instanced", "speedup");
+        for (unsigned int count : COUNTS)
+        {
+            std::vector<glm::vec3> positions = gridPositions(count, spacing);
+            // the whole grid in view, from above and in front of it
+            float extent = std::sqrt((float)count) * spacing;
+            glm::vec3 eye(0.0f, extent * 0.8f + 0.5f, extent * 0.8f + 0.5f);
+            FrameBlock frame = {glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, extent * 4.0f + 10.0f),
+                                glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec4(eye, 0.0f)};
+            frameBuffer.Update(frame);
+
+            double draws = millisPerFrame(frames, [&](int i) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                shader.use();
+                float angle = 2.0f * i / 60.0f;
+                for (const glm::vec3 &position : positions)
+                {
+                    glm::mat4 m = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(scale));
+                    m = glm::rotate(m, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+                    model.Set(m);
+                    normalMatrix.Set(NormalMatrix(m));
+                    diamond.Draw(shader);
+                }
+            });
+
+            double instanced = millisPerFrame(frames, [&](int i) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                instancedShader.use();
+                time.Set(i / 60.0f);
+                instanceData.resize(positions.size());
+                for (size_t j = 0; j < positions.size(); j++)
+                {
+                    instanceData[j].model = glm::scale(glm::translate(glm::mat4(1.0f), positions[j]), glm::vec3(scale));
+                    instanceData[j].spin = 2.0f;
+                    instanceData[j].normalMatrix = NormalMatrix(instanceData[j].model);
+                }
+                instances.Update(instanceData);
+                for (Mesh &mesh : diamond.meshes)
+                {
+                    instances.Attach(mesh.InstancedVAO());
+                    mesh.DrawInstanced(instancedShader, instances.Count());
+                }
+            });
+
+            std::printf("%10u %12.3f %12.3f %8.1fx\n", count, draws, instanced, draws / instanced);
+        }
+
+        instances.Release();
+        frameBuffer.Release();
+        lightsBuffer.Release();
+        glDeleteProgram(shader.ID);
+        glDeleteProgram(instancedShader.ID);
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
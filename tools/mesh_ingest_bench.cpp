@@ -0,0 +1,123 @@
+// ingestion benchmark: counts the heap allocations and peak resident memory of importing each model through ASSIMP
+// into Model's CPU-side mesh data (the mesh cache is bypassed). Every model is imported in its own forked process,
+// so the peak RSS of one model is not hidden by a bigger one imported before it.
+//
+// usage: mesh_ingest_bench [model...]
+//   without arguments the models shipped in resources/objects are measured, run it from the repository root
+
+#include <learnopengl/model.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static std::atomic<size_t> allocationCount{0};
+static std::atomic<size_t> allocatedBytes{0};
+
+void *operator new(size_t size)
+{
+    allocationCount++;
+    allocatedBytes += size;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+struct AllocationSnapshot
+{
+    size_t count;
+    size_t bytes;
+    static AllocationSnapshot Take() { return {allocationCount.load(), allocatedBytes.load()}; }
+};
+
+static long peakRssKB()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;    // kilobytes on Linux
+}
+
+// runs in the child process
+static int measure(const std::string &path)
+{
+    // ASSIMP on its own, the floor any ingestion path has to pay
+    AllocationSnapshot before = AllocationSnapshot::Take();
+    {
+        Assimp::Importer importer;
+        if (!importer.ReadFile(path, MODEL_IMPORT_FLAGS))
+        {
+            std::printf("ERROR::BENCH:: %s: %s\n", path.c_str(), importer.GetErrorString());
+            return 1;
+        }
+    }
+    AllocationSnapshot assimp = AllocationSnapshot::Take();
+
+    Model model;
+    model.useMeshCache = false;
+    model.useObjLoader = false;
+    model.Import(path);
+    AllocationSnapshot imported = AllocationSnapshot::Take();
+
+    size_t assimpCount = assimp.count - before.count;
+    size_t assimpBytes = assimp.bytes - before.bytes;
+    size_t importCount = imported.count - assimp.count;
+    size_t importBytes = imported.bytes - assimp.bytes;
+    size_t geometryBytes = model.ImportedGeometryBytes();
+    // what Model::Import allocated on top of ASSIMP, relative to the geometry it keeps. 1.0 means every byte was allocated once.
+    double overhead = geometryBytes > 0 && importBytes > assimpBytes ? (double)(importBytes - assimpBytes) / geometryBytes : 0.0;
+    std::printf("%-45s %10zu %10zu %10zu %10.1f %10.1f %8.2fx %10.1f\n", path.c_str(), assimpCount, importCount,
+                importCount > assimpCount ? importCount - assimpCount : 0, importBytes / (1024.0 * 1024.0),
+                geometryBytes / (1024.0 * 1024.0), overhead, peakRssKB() / 1024.0);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths(argv + 1, argv + argc);
+    if (paths.empty())
+        paths = {"resources/objects/island/island.obj", "resources/objects/spyro/spyro.obj",
+                 "resources/objects/portal/portal.obj", "resources/objects/old_key/old_key.obj",
+                 "resources/objects/chest/chest.obj", "resources/objects/diamond/diamond.obj"};
+
+    std::printf("%-45s %10s %10s %10s %10s %10s %9s %10s\n", "model", "assimp", "import", "extra", "alloc MB",
+                "geom MB", "copies", "peak MB");
+    int failures = 0;
+    for (const std::string &path : paths)
+    {
+        std::fflush(stdout);
+        pid_t child = fork();
+        if (child < 0)
+        {
+            std::perror("fork");
+            return 1;
+        }
+        if (child == 0)
+        {
+            // keep the per-model log lines of Model::Import out of the table
+            std::freopen("/dev/null", "w", stderr);
+            std::cout.setstate(std::ios::failbit);
+            int result = measure(path);
+            std::fflush(stdout);
+            std::_Exit(result);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failures++;
+    }
+    std::printf("assimp/import/extra: allocation counts of ReadFile alone, of Model::Import and the difference.\n"
+                "copies: bytes Model::Import allocated beyond ReadFile per byte of geometry it keeps.\n");
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+// normal matrix benchmark: GPU time of the vertex stage with the normal matrix computed two ways:
+//   inverse - mat3(transpose(inverse(model))) per vertex, what light.vs did before
+//   uniform - light.vs as it is, the normal matrix computed once per draw on the CPU (NormalMatrix) and set as a uniform
+// a grid of 512x512 vertices is drawn a number of times per frame into a 1x1 viewport, so rasterization and fragment
+// shading are next to free and the GL_TIME_ELAPSED query measures the vertex work. Also prints the CPU cost of
+// NormalMatrix for a uniformly scaled model (upper 3x3 reused) and a non-uniformly scaled one (3x3 inverse).
+// Runs on a hidden window.
+//
+// usage: normal_matrix_bench [frames] [draws per frame]
+//   run it from the repository root
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static const unsigned int GRID = 512;
+
+// light.vs before the normal matrix moved out of it
+static const char *const INVERSE_VERTEX_SHADER = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+uniform mat4 model;
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
+)";
+// uses every output, so the compiler keeps the normal computation in both variants
+static const char *const FRAGMENT_SHADER = R"(#version 330 core
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+out vec4 FragColor;
+void main()
+{
+    FragColor = vec4(normalize(Normal) + FragPos * 0.001, TexCoords.x);
+}
+)";
+
+struct FrameBlock { glm::mat4 projection, view; glm::vec4 viewPosition; };
+
+static Mesh makeGrid()
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    for (unsigned int y = 0; y < GRID; y++)
+    {
+        for (unsigned int x = 0; x < GRID; x++)
+        {
+            Vertex vertex = Vertex();
+            vertex.Position = glm::vec3((float)x / GRID - 0.5f, 0.0f, (float)y / GRID - 0.5f);
+            vertex.Normal = glm::normalize(glm::vec3(std::sin(x * 0.1f), 1.0f, std::cos(y * 0.1f)));
+            vertex.TexCoords = glm::vec2((float)x / GRID, (float)y / GRID);
+            vertices.push_back(vertex);
+        }
+    }
+    for (unsigned int y = 0; y + 1 < GRID; y++)
+    {
+        for (unsigned int x = 0; x + 1 < GRID; x++)
+        {
+            unsigned int i = y * GRID + x;
+            unsigned int quad[6] = {i, i + GRID, i + 1, i + 1, i + GRID, i + GRID + 1};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    return Mesh(std::move(vertices), std::move(indices), vector<Texture>());
+}
+
+// best GPU time of a frame in milliseconds
+template<typename F>
+static double gpuMillis(int frames, F frame)
+{
+    GLuint query;
+    glGenQueries(1, &query);
+    double best = 1e30;
+    for (int i = 0; i <= frames; i++)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        frame();
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 nanos = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanos);
+        // the first frame warms up the driver
+        if (i > 0)
+            best = std::min(best, nanos / 1e6);
+    }
+    glDeleteQueries(1, &query);
+    return best;
+}
+
+static double nanosPerCall(const glm::mat4 &model)
+{
+    const int calls = 1000000;
+    float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++)
+    {
+        glm::mat4 m = model;
+        m[3][0] = (float)i;     // a different matrix every call
+        sink += NormalMatrix(m)[0][0];
+    }
+    double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+    return sink == 12345.0f ? 0.0 : nanos;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+    int draws = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+    if (!glfwInit())
+        return 1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "normal_matrix_bench", NULL, NULL);
+    if (!window)
+    {
+        std::printf("could not create a GL 3.3 context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+        return 1;
+    LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
+
+    {
+        AssetData lightVertexFile;
+        if (!lightVertexFile.Open("resources/shaders/light.vs"))
+        {
+            std::printf("could not read resources/shaders/light.vs, run it from the repository root\n");
+            return 1;
+        }
+        Shader inverseShader = Shader::FromSource("normal_matrix_bench inverse", INVERSE_VERTEX_SHADER, FRAGMENT_SHADER);
+        Shader uniformShader = Shader::FromSource("normal_matrix_bench light.vs", lightVertexFile.String(), FRAGMENT_SHADER);
+        Mesh grid = makeGrid();
+
+        UniformBuffer<FrameBlock> frameBuffer(FRAME_DATA_BINDING);
+        glm::vec3 eye(0.0f, 1.0f, 1.5f);
+        frameBuffer.Update(FrameBlock{glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 10.0f),
+                                      glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec4(eye, 0.0f)});
+        // scaled non-uniformly, so the CPU side takes the inverse path too
+        glm::mat4 model = glm::scale(glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f, 2.0f, 1.0f));
+        UniformHandle<glm::mat4> inverseModel = inverseShader.Uniform<glm::mat4>("model");
+        UniformHandle<glm::mat4> uniformModel = uniformShader.Uniform<glm::mat4>("model");
+        UniformHandle<glm::mat3> normalMatrix = uniformShader.Uniform<glm::mat3>("normalMatrix");
+
+        glViewport(0, 0, 1, 1);
+        glEnable(GL_DEPTH_TEST);
+        double inverse = gpuMillis(frames, [&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            inverseShader.use();
+            for (int i = 0; i < draws; i++)
+            {
+                inverseModel.Set(model);
+                grid.Draw(inverseShader);
+            }
+        });
+        double uniform = gpuMillis(frames, [&]() {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            uniformShader.use();
+            for (int i = 0; i < draws; i++)
+            {
+                uniformModel.Set(model);
+                normalMatrix.Set(NormalMatrix(model));
+                grid.Draw(uniformShader);
+            }
+        });
+
+        double vertices = (double)GRID * GRID * draws;
+        std::printf("%.0f vertices per frame (%d draws), best of %d frames, GPU time\n", vertices, draws, frames);
+        std::printf("  inverse (per vertex):   %8.3f ms, %6.3f ns/vertex\n", inverse, inverse * 1e6 / vertices);
+        std::printf("  uniform (per draw):     %8.3f ms, %6.3f ns/vertex (%.2fx)\n", uniform, uniform * 1e6 / vertices, inverse / uniform);
+        std::printf("NormalMatrix on the CPU: %.1f ns uniform scale (upper 3x3), %.1f ns non-uniform scale (3x3 inverse)\n",
+                    nanosPerCall(glm::scale(glm::mat4(1.0f), glm::vec3(2.0f))), nanosPerCall(model));
+
+        grid.Release();
+        frameBuffer.Release();
+        glDeleteProgram(inverseShader.ID);
+        glDeleteProgram(uniformShader.ID);
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
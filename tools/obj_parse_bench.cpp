@@ -0,0 +1,79 @@
+// OBJ parsing benchmark: time to turn an .obj file into triangle meshes with ASSIMP's ReadFile (MODEL_IMPORT_FLAGS)
+// versus the native reader in obj_loader.h, with one thread and with every hardware thread. Only the parsing is timed,
+// the mesh optimization Model::Import runs afterwards is the same for both. Each measurement is the best of several runs,
+// so the file is in the page cache for all of them.
+//
+// usage: obj_parse_bench [runs] [model...]
+//   without models island.obj and spyro.obj are measured, run it from the repository root
+
+#include <learnopengl/model.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<typename F>
+static double bestMillis(int runs, F run)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (!run())
+            return -1.0;
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+    std::vector<std::string> paths(argv + std::min(argc, 2), argv + argc);
+    if (paths.empty())
+        paths = {"resources/objects/island/island.obj", "resources/objects/spyro/spyro.obj"};
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("%-40s %10s %10s %10s %9s %9s\n", "model", "assimp ms", "obj 1t ms", "obj Nt ms", "1t gain", "Nt gain");
+    int failures = 0;
+    for (const std::string &path : paths)
+    {
+        size_t assimpTriangles = 0, objTriangles = 0;
+        double assimp = bestMillis(runs, [&]() {
+            Assimp::Importer importer;
+            const aiScene *scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+            if (!scene)
+                return false;
+            assimpTriangles = 0;
+            for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+                assimpTriangles += scene->mMeshes[m]->mNumFaces;
+            return true;
+        });
+        auto native = [&](unsigned int threadCount) {
+            return bestMillis(runs, [&]() {
+                ObjScene scene;
+                if (!LoadObj(path, scene, threadCount))
+                    return false;
+                objTriangles = 0;
+                for (const ObjMesh &mesh : scene.meshes)
+                    objTriangles += mesh.indices.size() / 3;
+                return true;
+            });
+        };
+        double single = native(1);
+        double parallel = native(threads);
+        if (assimp < 0.0 || single < 0.0 || parallel < 0.0 || assimpTriangles != objTriangles)
+        {
+            std::printf("%-40s failed (assimp %zu triangles, obj %zu triangles)\n", path.c_str(), assimpTriangles, objTriangles);
+            failures++;
+            continue;
+        }
+        std::printf("%-40s %10.2f %10.2f %10.2f %8.1fx %8.1fx\n", path.c_str(), assimp, single, parallel, assimp / single, assimp / parallel);
+    }
+    std::printf("best of %d runs, N = %u threads. gain: ASSIMP time divided by the native reader's.\n", runs, threads);
+    return failures > 0 ? 1 : 0;
+}
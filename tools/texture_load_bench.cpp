@@ -0,0 +1,136 @@
+// texture loading benchmark: wall time until a set of images is sampleable, loaded two ways:
+//   sync  - what loadTexture did before the TextureLoader: stbi_load, glTexImage2D and glGenerateMipmap one image
+//           after the other on the GL thread
+//   async - TextureLoader::Load2D for every image up front, decoded on the worker pool while the GL thread uploads
+//           whatever is ready (the loader prefers an up-to-date .ctex next to an image, as it does in the application)
+// each round is timed until glFinish returns, the best round is printed with its throughput in MB of decoded images
+// per second. Runs on a hidden window.
+//
+// usage: texture_load_bench [rounds] [image...]
+//   run it from the repository root
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/texture_loader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double millisSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// loads every image on this thread, returns the bytes of the decoded images
+static size_t loadSync(const std::vector<std::string> &paths, std::vector<GLuint> &ids)
+{
+    size_t bytes = 0;
+    for (const std::string &path : paths)
+    {
+        int width, height, components;
+        unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &components, 0);
+        if (!pixels)
+        {
+            std::printf("could not load %s\n", path.c_str());
+            continue;
+        }
+        GLenum format = components == 1 ? GL_RED : components == 2 ? GL_RG : components == 4 ? GL_RGBA : GL_RGB;
+        GLuint id;
+        glGenTextures(1, &id);
+        GLState::Instance().BindTexture(GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        stbi_image_free(pixels);
+        bytes += (size_t)width * height * components;
+        ids.push_back(id);
+    }
+    return bytes;
+}
+
+// requests every image from the loader and uploads until all of them are done, returns the uploaded bytes
+static size_t loadAsync(const std::vector<std::string> &paths, std::vector<GLuint> &ids)
+{
+    TextureLoader &loader = TextureLoader::Instance();
+    std::vector<TextureHandle> textures;
+    for (const std::string &path : paths)
+        textures.push_back(loader.Load2D(path));
+    while (loader.Busy())
+    {
+        if (loader.ProcessUploads() == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    size_t bytes = 0;
+    for (const TextureHandle &texture : textures)
+    {
+        bytes += texture->bytes;
+        ids.push_back(texture->id);
+    }
+    return bytes;
+}
+
+template<typename F>
+static double bestMillis(int rounds, size_t &bytes, F load)
+{
+    double best = 1e30;
+    for (int i = 0; i < rounds; i++)
+    {
+        std::vector<GLuint> ids;
+        auto start = std::chrono::steady_clock::now();
+        bytes = load(ids);
+        glFinish();
+        best = std::min(best, millisSince(start));
+        for (GLuint id : ids)
+            GLState::Instance().DeleteTexture(id);
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+    std::vector<std::string> paths(argc > 2 ? argv + 2 : argv + argc, argv + argc);
+    if (paths.empty())
+        paths = {"resources/textures/portal_textures/water.jpg", "resources/textures/portal_textures/specular_map.jpg",
+                 "resources/textures/cubemap/cloudtop_back.jpg", "resources/textures/cubemap/cloudtop_bottom.jpg",
+                 "resources/textures/cubemap/cloudtop_front.jpg", "resources/textures/cubemap/cloudtop_left.jpg",
+                 "resources/textures/cubemap/cloudtop_right.jpg", "resources/textures/cubemap/cloudtop_top.jpg"};
+    if (!glfwInit())
+        return 1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "texture_load_bench", NULL, NULL);
+    if (!window)
+    {
+        std::printf("could not create a GL 3.3 context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+        return 1;
+    LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
+
+    size_t syncBytes = 0, asyncBytes = 0;
+    double sync = bestMillis(rounds, syncBytes, [&](std::vector<GLuint> &ids) { return loadSync(paths, ids); });
+    double async = bestMillis(rounds, asyncBytes, [&](std::vector<GLuint> &ids) { return loadAsync(paths, ids); });
+
+    std::printf("%zu images, best of %d rounds, until glFinish\n", paths.size(), rounds);
+    std::printf("  sync:  %9.2f ms, %8.1f MB/s\n", sync, syncBytes / (1024.0 * 1024.0) * 1000.0 / sync);
+    std::printf("  async: %9.2f ms, %8.1f MB/s (%.2fx) on %u decode threads\n", async,
+                asyncBytes / (1024.0 * 1024.0) * 1000.0 / async, sync / async, std::max(1u, std::thread::hardware_concurrency()));
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
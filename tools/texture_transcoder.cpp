@@ -0,0 +1,107 @@
+// offline transcoder: encodes images into block-compressed .ctex containers that TextureFromFile/loadTexture
+// pick up instead of decoding the original, and reports the encoder quality (PSNR) and speed.
+//
+// usage: texture_transcoder [--format bc1|bc3|bc4|bc5] [--min-psnr dB] image...
+//   without --format the block format follows the channel count: 1 -> BC4, 3 -> BC1, 2/4 -> BC3
+//   an image whose PSNR falls below --min-psnr is reported and makes the exit status nonzero, so a run over the
+//   repository's textures catches an encoder regression. Without it the floor depends on the format: the endpoint
+//   fit of the color blocks loses more than the 8-level single channel blocks
+
+#include <stb_image.h>
+#include <learnopengl/texture_compression.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static double defaultMinimumPSNR(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC4: return 36.0;
+    case BlockFormat::BC5: return 34.0;
+    default: return 28.0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool forceFormat = false;
+    BlockFormat format = BlockFormat::BC1;
+    double minimumPSNR = 0.0; // 0 picks the floor of the format
+    int failures = 0;
+    int processed = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+        {
+            std::string name = argv[++i];
+            forceFormat = true;
+            if (name == "bc1") format = BlockFormat::BC1;
+            else if (name == "bc3") format = BlockFormat::BC3;
+            else if (name == "bc4") format = BlockFormat::BC4;
+            else if (name == "bc5") format = BlockFormat::BC5;
+            else
+            {
+                std::cout << "ERROR::TRANSCODER:: unknown format " << name << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (arg == "--min-psnr" && i + 1 < argc)
+        {
+            minimumPSNR = std::atof(argv[++i]);
+            continue;
+        }
+
+        int width, height, components;
+        unsigned char *pixels = stbi_load(arg.c_str(), &width, &height, &components, 0);
+        if (!pixels)
+        {
+            std::cout << "ERROR::TRANSCODER:: failed to load " << arg << std::endl;
+            failures++;
+            continue;
+        }
+        BlockFormat imageFormat = forceFormat ? format : DefaultBlockFormat(components);
+
+        auto start = std::chrono::steady_clock::now();
+        CompressedImage image = CompressImage(pixels, width, height, components, imageFormat);
+        double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        double psnr = MeasurePSNR(pixels, width, height, components, image.mips[0].data.data(), imageFormat);
+
+        size_t compressedBytes = 0;
+        for (const CompressedMip &mip : image.mips)
+            compressedBytes += mip.data.size();
+        // what the uncompressed upload costs in VRAM with its mip chain (4/3 of level 0, RGB padded to RGBA by most drivers)
+        double uncompressedBytes = (double)width * height * (components == 3 ? 4 : components) * 4.0 / 3.0;
+        double megapixels = (double)width * height / 1e6;
+
+        bool written = WriteCompressedTexture(arg, image);
+        std::cout << arg << ": " << width << "x" << height << "x" << components << " -> " << BlockFormatName(imageFormat)
+                  << ", " << image.mips.size() << " mips, PSNR " << psnr << " dB, " << encodeMs << " ms ("
+                  << (encodeMs > 0.0 ? megapixels * 1000.0 / encodeMs : 0.0) << " MP/s), "
+                  << compressedBytes / 1024 << " KB vs ~" << (size_t)(uncompressedBytes / 1024) << " KB uncompressed"
+                  << (written ? "" : " [WRITE FAILED]") << std::endl;
+        if (!written)
+            failures++;
+        double floor = minimumPSNR > 0.0 ? minimumPSNR : defaultMinimumPSNR(imageFormat);
+        if (psnr < floor)
+        {
+            std::cout << "ERROR::TRANSCODER:: " << arg << " PSNR " << psnr << " dB is below " << floor << " dB" << std::endl;
+            failures++;
+        }
+        processed++;
+        stbi_image_free(pixels);
+    }
+
+    if (processed == 0 && failures == 0)
+    {
+        std::cout << "usage: " << argv[0] << " [--format bc1|bc3|bc4|bc5] [--min-psnr dB] image..." << std::endl;
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
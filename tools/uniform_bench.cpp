@@ -0,0 +1,199 @@
+// uniform setup benchmark: CPU time the render loop spends per frame on the 35 uniform values main() used to set as
+// plain uniforms (camera, three lights, material and the per-draw model/transparency), set four ways:
+//   lookup  - std::string + glGetUniformLocation per call, what Shader::set* did before the location table
+//   table   - Shader::set*, std::string + lookup in the table reflected at link time
+//   handles - UniformHandle<T>::Set, one glUniform call
+//   blocks  - camera and lights written to the FrameData/Lights uniform buffers, only the per-draw values as uniforms
+// the first three use a shader with the old plain uniforms, built from the sources below. Runs on a hidden window;
+// the driver only buffers the calls, so this is CPU time on the calling thread.
+//
+// usage: uniform_bench [frames]
+//   run it from the repository root
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static const char *const VEC3_UNIFORMS[] = {
+    "viewPosition",
+    "dirLight.direction", "dirLight.ambient", "dirLight.diffuse", "dirLight.specular",
+    "pointLight.position", "pointLight.ambient", "pointLight.diffuse", "pointLight.specular",
+    "spotLight.position", "spotLight.direction", "spotLight.ambient", "spotLight.diffuse", "spotLight.specular",
+};
+static const char *const FLOAT_UNIFORMS[] = {
+    "material.shininess",
+    "pointLight.constant", "pointLight.linear", "pointLight.quadratic",
+    "spotLight.constant", "spotLight.linear", "spotLight.quadratic", "spotLight.cutOff", "spotLight.outerCutOff",
+};
+static const char *const INT_UNIFORMS[] = {"transparency", "transparency", "transparency", "transparency"};
+static const char *const MAT4_UNIFORMS[] = {"projection", "view", "model", "model", "model", "model", "model", "model"};
+
+// the uniforms of light.fs before they moved into blocks, each one used so the compiler keeps it
+static const char *const LEGACY_VERTEX_SHADER = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
+)";
+static const char *const LEGACY_FRAGMENT_SHADER = R"(#version 330 core
+out vec4 FragColor;
+struct DirLight { vec3 direction; vec3 ambient; vec3 diffuse; vec3 specular; };
+struct PointLight { vec3 position; vec3 ambient; vec3 diffuse; vec3 specular; float constant; float linear; float quadratic; };
+struct SpotLight { vec3 position; vec3 direction; float cutOff; float outerCutOff; float constant; float linear; float quadratic;
+                   vec3 ambient; vec3 diffuse; vec3 specular; };
+struct Material { float shininess; };
+uniform Material material;
+uniform DirLight dirLight;
+uniform PointLight pointLight;
+uniform SpotLight spotLight;
+uniform vec3 viewPosition;
+uniform int transparency;
+void main()
+{
+    vec3 sum = viewPosition + dirLight.direction + dirLight.ambient + dirLight.diffuse + dirLight.specular
+             + pointLight.position + pointLight.ambient + pointLight.diffuse + pointLight.specular
+             + spotLight.position + spotLight.direction + spotLight.ambient + spotLight.diffuse + spotLight.specular;
+    float f = material.shininess + pointLight.constant + pointLight.linear + pointLight.quadratic + spotLight.cutOff
+            + spotLight.outerCutOff + spotLight.constant + spotLight.linear + spotLight.quadratic + float(transparency);
+    FragColor = vec4(sum, f);
+}
+)";
+
+struct FrameBlock { glm::mat4 projection, view; glm::vec4 viewPosition; };
+struct LightsBlock { glm::vec4 slots[13]; };
+
+template<typename F>
+static double microsPerFrame(int frames, F frame)
+{
+    // best of a few rounds, the first one also warms the caches
+    double best = 1e30;
+    for (int round = 0; round < 5; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++)
+            frame(i);
+        best = std::min(best, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames);
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10000;
+    if (!glfwInit())
+        return 1;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "uniform_bench", NULL, NULL);
+    if (!window)
+    {
+        std::printf("could not create a GL 3.3 context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+        return 1;
+    LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
+
+    {
+        Shader shader = Shader::FromSource("uniform_bench legacy", LEGACY_VERTEX_SHADER, LEGACY_FRAGMENT_SHADER);
+        shader.use();
+        glm::vec3 v(0.5f);
+        glm::mat4 m(1.0f);
+
+        double lookup = microsPerFrame(frames, [&](int i) {
+            for (const char *name : VEC3_UNIFORMS)
+                glUniform3fv(glGetUniformLocation(shader.ID, std::string(name).c_str()), 1, &v[0]);
+            for (const char *name : FLOAT_UNIFORMS)
+                glUniform1f(glGetUniformLocation(shader.ID, std::string(name).c_str()), (float)i);
+            for (const char *name : INT_UNIFORMS)
+                glUniform1i(glGetUniformLocation(shader.ID, std::string(name).c_str()), i & 1);
+            for (const char *name : MAT4_UNIFORMS)
+                glUniformMatrix4fv(glGetUniformLocation(shader.ID, std::string(name).c_str()), 1, GL_FALSE, &m[0][0]);
+        });
+
+        double table = microsPerFrame(frames, [&](int i) {
+            for (const char *name : VEC3_UNIFORMS)
+                shader.setVec3(name, v);
+            for (const char *name : FLOAT_UNIFORMS)
+                shader.setFloat(name, (float)i);
+            for (const char *name : INT_UNIFORMS)
+                shader.setInt(name, i & 1);
+            for (const char *name : MAT4_UNIFORMS)
+                shader.setMat4(name, m);
+        });
+
+        std::vector<UniformHandle<glm::vec3>> vec3s;
+        std::vector<UniformHandle<float>> floats;
+        std::vector<UniformHandle<int>> ints;
+        std::vector<UniformHandle<glm::mat4>> mat4s;
+        for (const char *name : VEC3_UNIFORMS)
+            vec3s.push_back(shader.Uniform<glm::vec3>(name));
+        for (const char *name : FLOAT_UNIFORMS)
+            floats.push_back(shader.Uniform<float>(name));
+        for (const char *name : INT_UNIFORMS)
+            ints.push_back(shader.Uniform<int>(name));
+        for (const char *name : MAT4_UNIFORMS)
+            mat4s.push_back(shader.Uniform<glm::mat4>(name));
+        double handles = microsPerFrame(frames, [&](int i) {
+            for (const UniformHandle<glm::vec3> &handle : vec3s)
+                handle.Set(v);
+            for (const UniformHandle<float> &handle : floats)
+                handle.Set((float)i);
+            for (const UniformHandle<int> &handle : ints)
+                handle.Set(i & 1);
+            for (const UniformHandle<glm::mat4> &handle : mat4s)
+                handle.Set(m);
+        });
+
+        // per draw: shininess, 4 transparency and 6 model uniforms as handles, the rest through the two buffers
+        UniformBuffer<FrameBlock> frameBuffer(FRAME_DATA_BINDING);
+        UniformBuffer<LightsBlock> lightsBuffer(LIGHTS_BINDING);
+        FrameBlock frame = {m, m, glm::vec4(v, 0.0f)};
+        LightsBlock lights;
+        for (glm::vec4 &slot : lights.slots)
+            slot = glm::vec4(v, 0.5f);
+        double blocks = microsPerFrame(frames, [&](int i) {
+            frame.viewPosition.w = (float)i;
+            frameBuffer.Update(frame);
+            lightsBuffer.Update(lights);
+            floats[0].Set((float)i);
+            for (const UniformHandle<int> &handle : ints)
+                handle.Set(i & 1);
+            for (size_t draw = 2; draw < mat4s.size(); draw++)
+                mat4s[draw].Set(m);
+        });
+
+        size_t count = vec3s.size() + floats.size() + ints.size() + mat4s.size();
+        size_t blockCalls = 2 * 2 + 1 + ints.size() + mat4s.size() - 2;
+        std::printf("%zu uniform values per frame, %d frames\n", count, frames);
+        std::printf("  lookup  (string + glGetUniformLocation): %8.3f us/frame, %zu GL calls\n", lookup, 2 * count);
+        std::printf("  table   (string + reflected table):      %8.3f us/frame, %zu GL calls (%.1fx)\n", table, count, lookup / table);
+        std::printf("  handles (UniformHandle<T>::Set):         %8.3f us/frame, %zu GL calls (%.1fx)\n", handles, count, lookup / handles);
+        std::printf("  blocks  (2 uniform buffers + handles):   %8.3f us/frame, %zu GL calls (%.1fx)\n", blocks, blockCalls, lookup / blocks);
+        frameBuffer.Release();
+        lightsBuffer.Release();
+        glDeleteProgram(shader.ID);
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}